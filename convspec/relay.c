@@ -157,14 +157,13 @@ static void BuildCallFrom16Core( int reg_func, int thunk )
     output( "\tshrl $1, %%edx\n" );
     if (UsePIC)
     {
-        output( "\taddl wine_ldt_copy_ptr-1b(%%ecx),%%edx\n" );
-        output( "\tmovl (%%edx), %%edx\n" );
+        /* wine_ldt_copy_ptr holds the address of the import slot */
+        output( "\tmovl wine_ldt_copy_ptr-1b(%%ecx),%%ecx\n" );
+        output( "\tmovl (%%ecx),%%ecx\n" );
     }
     else
-    {
         output( "\tmovl %s, %%ecx\n", asm_name("_imp__wine_ldt_copy") );
-        output( "\tmovl 0(%%ecx,%%edx), %%edx\n" );
-    }
+    output( "\tmovl 0(%%ecx,%%edx), %%edx\n" );
     output( "\tmovzwl %%sp, %%ebp\n" );
     output( "\tleal %d(%%ebp,%%edx), %%edx\n", reg_func ? 0 : -4 );
 
@@ -359,10 +359,11 @@ static void output_call16_function( ORDDEF *odp )
         {
             output( "\tcalll %s\n", asm_name("__wine_spec_get_pc_thunk_eax") );
             output( "1:\tmovl wine_ldt_copy_ptr-1b(%%eax),%%esi\n" );
+            output( "\tmovl (%%esi),%%esi\n" );
             needs_get_pc_thunk = 1;
         }
-        else
-            output( "\tmovl $%s,%%esi\n", asm_name("_imp__wine_ldt_copy") );
+        else  /* wine_ldt_copy is imported, load its address from the import slot */
+            output( "\tmovl %s,%%esi\n", asm_name("_imp__wine_ldt_copy") );
     }
 
     /* preserve 16-byte stack alignment */
@@ -814,6 +815,7 @@ static void output_module16( DLLSPEC *spec )
     if (nb_funcs)
     {
         output( "\n/* relay functions */\n\n" );
+        output( ".code32\n" );
         output( "\t.text\n" );
         for ( i = 0; i < nb_funcs; i++ ) output_call16_function( typelist[i] );
         output( "\t.data\n" );
@@ -1386,6 +1386,276 @@ struct ini_redirect_data ini_redirect_list[] =
     {"win.ini", "mci extensions", NULL, NULL, NULL, NULL, TRUE},
 };
 
+/* Cache of the profile values read through the 16-bit functions. The Win32
+ * profile API reopens and parses the file on every call, and old programs
+ * read hundreds of keys at startup or poll them from timers. The values of
+ * a file are dropped when its size or write time changes, and every file
+ * is dropped on any write through the 16-bit functions. Sections that the
+ * registry IniFileMapping redirects elsewhere are never cached. */
+#define PROFILE_CACHE_FILES  8
+#define PROFILE_CACHE_HASH   256
+#define PROFILE_CACHE_MAX    4096   /* values per file */
+
+struct profile_value
+{
+    struct profile_value *next;
+    DWORD  hash;
+    BOOL   cached;      /* FALSE if it must be read through the API */
+    char  *value;       /* NULL if the key doesn't exist */
+    char   name[1];     /* section, '\0', key */
+};
+
+struct profile_file
+{
+    char      path[MAX_PATH];
+    FILETIME  time;
+    DWORD     size;
+    DWORD     count;
+    struct profile_value *hash[PROFILE_CACHE_HASH];
+};
+
+static struct profile_file *profile_cache[PROFILE_CACHE_FILES];
+static int profile_cache_next;
+
+static CRITICAL_SECTION profile_section;
+static CRITICAL_SECTION_DEBUG profile_critsect_debug =
+{
+    0, 0, &profile_section,
+    { &profile_critsect_debug.ProcessLocksList, &profile_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": profile_section") }
+};
+static CRITICAL_SECTION profile_section = { &profile_critsect_debug, -1, 0, 0, 0, 0 };
+
+static DWORD profile_hash( LPCSTR section, LPCSTR key )
+{
+    DWORD hash = 0;
+    while (*section) hash = hash * 31 + toupper( (unsigned char)*section++ );
+    hash = hash * 31;
+    while (*key) hash = hash * 31 + toupper( (unsigned char)*key++ );
+    return hash;
+}
+
+static void profile_free_values( struct profile_file *file )
+{
+    int i;
+
+    for (i = 0; i < PROFILE_CACHE_HASH; i++)
+    {
+        struct profile_value *value = file->hash[i], *next;
+        for (; value; value = next)
+        {
+            next = value->next;
+            HeapFree( GetProcessHeap(), 0, value->value );
+            HeapFree( GetProcessHeap(), 0, value );
+        }
+        file->hash[i] = NULL;
+    }
+    file->count = 0;
+}
+
+/***********************************************************************
+ *           PROFILE_InvalidateCache
+ *
+ * Drop every cached profile value, after a write.
+ */
+static void PROFILE_InvalidateCache(void)
+{
+    int i;
+
+    EnterCriticalSection( &profile_section );
+    for (i = 0; i < PROFILE_CACHE_FILES; i++)
+    {
+        if (!profile_cache[i]) continue;
+        profile_free_values( profile_cache[i] );
+        HeapFree( GetProcessHeap(), 0, profile_cache[i] );
+        profile_cache[i] = NULL;
+    }
+    LeaveCriticalSection( &profile_section );
+}
+
+/* find the cache of a file, dropping its values if the file has changed */
+static struct profile_file *profile_get_file( LPCSTR path )
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    struct profile_file *file = NULL;
+    char full_path[MAX_PATH];
+    DWORD len;
+    int i;
+
+    /* relative paths depend on the current directory */
+    len = GetFullPathNameA( path, sizeof(full_path), full_path, NULL );
+    if (!len || len >= sizeof(full_path)) return NULL;
+    path = full_path;
+    if (!GetFileAttributesExA( path, GetFileExInfoStandard, &data ))
+        memset( &data, 0, sizeof(data) );
+
+    for (i = 0; i < PROFILE_CACHE_FILES; i++)
+    {
+        if (profile_cache[i] && !stricmp( profile_cache[i]->path, path ))
+        {
+            file = profile_cache[i];
+            break;
+        }
+    }
+    if (!file)
+    {
+        if (!(file = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*file) ))) return NULL;
+        strcpy( file->path, path );
+        i = profile_cache_next++ % PROFILE_CACHE_FILES;
+        if (profile_cache[i])
+        {
+            profile_free_values( profile_cache[i] );
+            HeapFree( GetProcessHeap(), 0, profile_cache[i] );
+        }
+        profile_cache[i] = file;
+    }
+    else if (CompareFileTime( &file->time, &data.ftLastWriteTime ) || file->size != data.nFileSizeLow ||
+             file->count >= PROFILE_CACHE_MAX)
+    {
+        profile_free_values( file );
+    }
+    file->time = data.ftLastWriteTime;
+    file->size = data.nFileSizeLow;
+    return file;
+}
+
+/* check whether IniFileMapping sends a section to the registry, either
+ * through a value or a subkey named after it, or through a default value */
+static BOOL profile_is_mapped( LPCSTR path, LPCSTR section )
+{
+    char key[MAX_PATH + 80];
+    HKEY hkey, hsubkey;
+    BOOL ret;
+
+    strcpy( key, "Software\\Microsoft\\Windows NT\\CurrentVersion\\IniFileMapping\\" );
+    strcat( key, PathFindFileNameA( path ) );
+    if (RegOpenKeyExA( HKEY_LOCAL_MACHINE, key, 0, KEY_QUERY_VALUE, &hkey )) return FALSE;
+    ret = !RegQueryValueExA( hkey, section, NULL, NULL, NULL, NULL ) ||
+          !RegQueryValueExA( hkey, NULL, NULL, NULL, NULL, NULL );
+    if (!ret && !RegOpenKeyExA( hkey, section, 0, KEY_QUERY_VALUE, &hsubkey ))
+    {
+        RegCloseKey( hsubkey );
+        ret = TRUE;
+    }
+    RegCloseKey( hkey );
+    return ret;
+}
+
+/* get the cache entry of a key, reading it on first use; profile_section must be held */
+static struct profile_value *profile_get_value( LPCSTR path, LPCSTR section, LPCSTR key )
+{
+    static const char missing[] = "\001";
+    struct profile_file *file;
+    struct profile_value *value;
+    DWORD hash = profile_hash( section, key );
+    SIZE_T section_len = strlen( section ), key_len = strlen( key );
+    char buffer[4096];
+    DWORD len;
+
+    if (!(file = profile_get_file( path ))) return NULL;
+
+    for (value = file->hash[hash % PROFILE_CACHE_HASH]; value; value = value->next)
+    {
+        if (value->hash == hash && !stricmp( value->name, section ) &&
+            !stricmp( value->name + strlen( value->name ) + 1, key ))
+            return value;
+    }
+
+    if (!(value = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                             FIELD_OFFSET( struct profile_value, name[section_len + key_len + 2] ))))
+        return NULL;
+    value->hash = hash;
+    memcpy( value->name, section, section_len + 1 );
+    memcpy( value->name + section_len + 1, key, key_len + 1 );
+
+    if (!profile_is_mapped( path, section ))
+    {
+        len = GetPrivateProfileStringA( section, key, missing, buffer, sizeof(buffer), path );
+        if (len < sizeof(buffer) - 2)
+        {
+            value->cached = TRUE;
+            if (strcmp( buffer, missing ) &&
+                (value->value = HeapAlloc( GetProcessHeap(), 0, len + 1 )))
+                memcpy( value->value, buffer, len + 1 );
+            else if (strcmp( buffer, missing ))
+                value->cached = FALSE;
+        }
+    }
+    value->next = file->hash[hash % PROFILE_CACHE_HASH];
+    file->hash[hash % PROFILE_CACHE_HASH] = value;
+    file->count++;
+    return value;
+}
+
+/***********************************************************************
+ *           PROFILE_GetString
+ *
+ * GetPrivateProfileStringA for a single key, through the cache.
+ */
+static INT16 PROFILE_GetString( LPCSTR section, LPCSTR entry, LPCSTR def_val,
+                                LPSTR buffer, UINT16 len, LPCSTR filename )
+{
+    struct profile_value *value;
+    LPCSTR str;
+    SIZE_T size;
+
+    if (!buffer || !len) return GetPrivateProfileStringA( section, entry, def_val, buffer, len, filename );
+
+    EnterCriticalSection( &profile_section );
+    value = profile_get_value( filename, section, entry );
+    if (!value || !value->cached)
+    {
+        LeaveCriticalSection( &profile_section );
+        return GetPrivateProfileStringA( section, entry, def_val, buffer, len, filename );
+    }
+    if (value->value)
+    {
+        str = value->value;
+        size = strlen( str );
+    }
+    else
+    {
+        /* the default value is returned without its trailing blanks */
+        str = def_val ? def_val : "";
+        size = strlen( str );
+        while (size && str[size - 1] == ' ') size--;
+    }
+    size = min( size, len - 1 );
+    memcpy( buffer, str, size );
+    buffer[size] = 0;
+    LeaveCriticalSection( &profile_section );
+    return size;
+}
+
+/***********************************************************************
+ *           PROFILE_GetInt
+ *
+ * GetPrivateProfileIntA through the cache.
+ */
+static UINT PROFILE_GetInt( LPCSTR section, LPCSTR entry, INT def_val, LPCSTR filename )
+{
+    struct profile_value *value;
+    char buffer[30];
+    ULONG result = def_val;
+
+    if (!section || !entry || !filename) return GetPrivateProfileIntA( section, entry, def_val, filename );
+
+    EnterCriticalSection( &profile_section );
+    value = profile_get_value( filename, section, entry );
+    if (!value || !value->cached)
+    {
+        LeaveCriticalSection( &profile_section );
+        return GetPrivateProfileIntA( section, entry, def_val, filename );
+    }
+    if (value->value && value->value[0])
+    {
+        lstrcpynA( buffer, value->value, sizeof(buffer) );
+        RtlCharToInteger( buffer, 10, &result );
+    }
+    LeaveCriticalSection( &profile_section );
+    return result;
+}
+
 /***********************************************************************
  *           GetPrivateProfileInt   (KERNEL.127)
  */
@@ -1411,7 +1681,7 @@ UINT16 WINAPI GetPrivateProfileInt16( LPCSTR section, LPCSTR entry,
         }
     }
     RedirectPrivateProfileStringWindowsDir(filename,ini);
-    return (INT16)GetPrivateProfileIntA(section,entry,def_val,ini);
+    return (INT16)PROFILE_GetInt(section,entry,def_val,ini);
 }
 
 
@@ -1642,7 +1912,7 @@ INT16 WINAPI GetPrivateProfileString16( LPCSTR section, LPCSTR entry,
         }
         return 0;
     }
-    return GetPrivateProfileStringA( section, entry, def_val, buffer, len, filename );
+    return PROFILE_GetString( section, entry, def_val, buffer, len, filename );
 }
 
 static BOOL16 check_write_profile_error(LPCSTR filename, DWORD error)
@@ -1670,6 +1940,7 @@ BOOL16 WINAPI WritePrivateProfileString16( LPCSTR section, LPCSTR entry,
     RedirectPrivateProfileStringWindowsDir(filename, &filenamebuf);
     filename = filenamebuf;
     BOOL ret = WritePrivateProfileStringA(section,entry,string,filename);
+    PROFILE_InvalidateCache();
     if (!ret)
         return check_write_profile_error(filename, GetLastError());
     return ret;
@@ -1822,7 +2093,9 @@ BOOL16 WINAPI WritePrivateProfileStruct16 (LPCSTR section, LPCSTR key,
     char filenamebuf[MAX_PATH];
     RedirectPrivateProfileStringWindowsDir(filename, &filenamebuf);
     filename = filenamebuf;
-    return WritePrivateProfileStructA( section, key, buf, bufsize, filename );
+    BOOL16 ret = WritePrivateProfileStructA( section, key, buf, bufsize, filename );
+    PROFILE_InvalidateCache();
+    return ret;
 }
 
 
@@ -1944,7 +2217,9 @@ BOOL16 WINAPI FindClose16( HANDLE16 handle )
 BOOL16 WINAPI WritePrivateProfileSection16( LPCSTR section,
                                             LPCSTR string, LPCSTR filename )
 {
-    return WritePrivateProfileSectionA( section, string, filename );
+    BOOL16 ret = WritePrivateProfileSectionA( section, string, filename );
+    PROFILE_InvalidateCache();
+    return ret;
 }
 
 
@@ -82,6 +82,63 @@ static DWORD *selTable;
 #define VALID_HANDLE(handle) (((handle)&4)&&(((handle)>>__AHSHIFT)<globalArenaSize))
 #define GET_ARENA_PTR(handle)  (pGlobalArena + ((handle) >> __AHSHIFT))
 
+/*
+ * Lookup chains over the arena array, keyed by owner and by link handle.
+ * Entries are arena indexes + 1. An arena may stay filed under a stale
+ * key after it is cleared, so users must check the arena itself.
+ */
+#define GLOBAL_INDEX_BUCKETS 1024
+typedef struct
+{
+    WORD      bucket[GLOBAL_INDEX_BUCKETS];
+    WORD      next[GLOBAL_MAX_COUNT];
+    WORD      prev[GLOBAL_MAX_COUNT];
+    ULONG_PTR key[GLOBAL_MAX_COUNT];
+    BYTE      filed[GLOBAL_MAX_COUNT];
+} GLOBAL_INDEX;
+
+static GLOBAL_INDEX owner_index;
+static GLOBAL_INDEX link_index;
+
+static WORD *GLOBAL_IndexBucket( GLOBAL_INDEX *idx, ULONG_PTR key )
+{
+    return &idx->bucket[((key >> __AHSHIFT) ^ (key >> 16)) % GLOBAL_INDEX_BUCKETS];
+}
+
+static void GLOBAL_IndexRemove( GLOBAL_INDEX *idx, int i )
+{
+    if (!idx->filed[i]) return;
+    if (idx->prev[i]) idx->next[idx->prev[i] - 1] = idx->next[i];
+    else *GLOBAL_IndexBucket( idx, idx->key[i] ) = idx->next[i];
+    if (idx->next[i]) idx->prev[idx->next[i] - 1] = idx->prev[i];
+    idx->filed[i] = 0;
+}
+
+static void GLOBAL_IndexFile( GLOBAL_INDEX *idx, int i, ULONG_PTR key )
+{
+    WORD *bucket;
+
+    if (idx->filed[i] && idx->key[i] == key) return;
+    GLOBAL_IndexRemove( idx, i );
+    bucket = GLOBAL_IndexBucket( idx, key );
+    idx->key[i] = key;
+    idx->prev[i] = 0;
+    idx->next[i] = *bucket;
+    if (*bucket) idx->prev[*bucket - 1] = i + 1;
+    *bucket = i + 1;
+    idx->filed[i] = 1;
+}
+
+/* file an arena under its current owner and link, call after changing either */
+static void GLOBAL_UpdateIndex( GLOBALARENA *pArena )
+{
+    int i = pArena - pGlobalArena;
+
+    GLOBAL_IndexFile( &owner_index, i, pArena->hOwner );
+    if (pArena->link_hndl) GLOBAL_IndexFile( &link_index, i, (ULONG_PTR)pArena->link_hndl );
+    else GLOBAL_IndexRemove( &link_index, i );
+}
+
 static HANDLE get_win16_heap(void)
 {
     static HANDLE win16_heap;
@@ -209,6 +266,7 @@ HGLOBAL16 GLOBAL_CreateBlock( WORD flags, void *ptr, DWORD size,
         memset( pArena + 1, 0, (selcount - 1) * sizeof(GLOBALARENA) );
 
     set_sel_table(sel, selcount);
+    GLOBAL_UpdateIndex( pArena );
     return pArena->handle;
 }
 
@@ -252,6 +310,7 @@ BOOL16 GLOBAL_MoveBlock( HGLOBAL16 handle, void *ptr, DWORD size )
     pArena->base = ptr;
     pArena->size = size;
     SELECTOR_ReallocBlock( sel, ptr, size );
+    GLOBAL_UpdateIndex( pArena );
     return TRUE;
 }
 
@@ -314,18 +373,32 @@ HGLOBAL GLOBAL_GetLink(HGLOBAL16 hg)
 void GLOBAL_SetLink(HGLOBAL16 hg16, HGLOBAL hg)
 {
     GET_ARENA_PTR(hg16)->link_hndl = hg;
+    GLOBAL_UpdateIndex( GET_ARENA_PTR(hg16) );
 }
 
 HGLOBAL16 GLOBAL_FindLink(HGLOBAL hg)
 {
-    int i;
-    GLOBALARENA *pArena = pGlobalArena;
-    for (i = 0; i < globalArenaSize; i++, pArena++)
+    WORD i, found = 0;
+
+    if (!hg)
     {
-        if ((pArena->size != 0) && (pArena->link_hndl == hg))
-            return pArena->handle;
+        /* unlinked blocks are not indexed */
+        GLOBALARENA *pArena = pGlobalArena;
+        for (i = 0; i < globalArenaSize; i++, pArena++)
+        {
+            if ((pArena->size != 0) && (pArena->link_hndl == hg))
+                return pArena->handle;
+        }
+        return 0;
     }
-    return 0;
+    /* the lowest matching arena, as a scan of the arena would find */
+    for (i = *GLOBAL_IndexBucket( &link_index, (ULONG_PTR)hg ); i; i = link_index.next[i - 1])
+    {
+        GLOBALARENA *pArena = pGlobalArena + i - 1;
+        if ((pArena->size != 0) && (pArena->link_hndl == hg) && (!found || i < found))
+            found = i;
+    }
+    return found ? pGlobalArena[found - 1].handle : 0;
 }
 
 /***********************************************************************
@@ -546,6 +619,7 @@ HGLOBAL16 WINAPI GlobalReAlloc16(
     pNewArena->size = GetSelectorLimit16(sel) + 1 - add_size;
     pNewArena->selCount = selcount;
     pNewArena->handle = (pNewArena->flags & GA_MOVEABLE) ? sel - 1 : sel;
+    GLOBAL_UpdateIndex( pNewArena );
 
     if (selcount > 1)  /* clear the next arena blocks */
         memset( pNewArena + 1, 0, (selcount - 1) * sizeof(GLOBALARENA) );
@@ -1029,20 +1103,41 @@ DWORD WINAPI GlobalCompact16( DWORD desired )
 }
 
 
+static int compare_arena_index( const void *a, const void *b )
+{
+    return *(const WORD *)a - *(const WORD *)b;
+}
+
 /***********************************************************************
  *           GlobalFreeAll   (KERNEL.26)
  */
 void WINAPI GlobalFreeAll16( HGLOBAL16 owner )
 {
-    int i;
+    WORD *list;
+    int i, count = 0;
     GLOBALARENA *pArena;
 
-    pArena = pGlobalArena;
-    for (i = 0; i < globalArenaSize; i++, pArena++)
+    /* collect the owner's blocks first, freeing them unlinks them from the index */
+    for (i = *GLOBAL_IndexBucket( &owner_index, owner ); i; i = owner_index.next[i - 1])
+        count++;
+    if (!count) return;
+    if (!(list = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*list) ))) return;
+    count = 0;
+    for (i = *GLOBAL_IndexBucket( &owner_index, owner ); i; i = owner_index.next[i - 1])
+    {
+        pArena = pGlobalArena + i - 1;
+        if ((pArena->size != 0) && (pArena->hOwner == owner))
+            list[count++] = i - 1;
+    }
+    /* free in arena order */
+    qsort( list, count, sizeof(*list), compare_arena_index );
+    for (i = 0; i < count; i++)
     {
+        pArena = pGlobalArena + list[i];
         if ((pArena->size != 0) && (pArena->hOwner == owner))
             GlobalFree16( pArena->handle );
     }
+    HeapFree( GetProcessHeap(), 0, list );
 }
 
 
@@ -1239,6 +1334,7 @@ void WINAPI FarSetOwner16( HGLOBAL16 handle, HANDLE16 hOwner )
 	return;
     }
     GET_ARENA_PTR(handle)->hOwner = hOwner;
+    GLOBAL_UpdateIndex( GET_ARENA_PTR(handle) );
 }
 
 
@@ -1392,4 +1488,5 @@ void WINAPI GlobalMapInternal(WORD sel, void *base, DWORD size)
     pArena->base = base;
     pArena->size = size;
     pArena->wType = GT_INTERNAL;
+    GLOBAL_UpdateIndex( pArena );
 }
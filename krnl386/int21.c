@@ -3871,8 +3871,201 @@ static BOOL INT21_ToDosFCBFormat( LPCWSTR name, LPWSTR buffer )
     return (!*p || (*p == '/') || (*p == '\\'));
 }
 
-static HANDLE       INT21_FindHandle;
-static const WCHAR *INT21_FindPath; /* will point to current dta->fullPath search */
+/* Directory listings of the active FindFirst/FindNext searches, keyed by
+ * dta->fullPath / pFCB->fullPath. The entries are read lazily from the find
+ * handle and kept, so that a search resumed after another one only indexes
+ * the listing instead of replaying FindNextFileW from the start. Like before,
+ * only one find handle is kept open, so that abandoned searches don't keep
+ * directories busy: the listing that loses it is read to the end first. */
+#define FIND_CACHE_SEARCHES  8
+
+#define FIND_ENTRY_VALID     0x01  /* fcb_name is a valid 8.3 name */
+#define FIND_ENTRY_LARGE_DIR 0x02  /* skipped by acmsetup, see INT21_FindHelper */
+
+typedef struct
+{
+    DWORD    attr;
+    DWORD    size;
+    FILETIME creation;
+    FILETIME write;
+    BYTE     flags;
+    WCHAR    name[13];      /* short name, as returned to the program */
+    WCHAR    fcb_name[12];  /* name in FCB format, for matching */
+} FIND_CACHE_ENTRY;
+
+typedef struct
+{
+    const WCHAR      *key;      /* fullPath of the search owning this listing */
+    HANDLE            handle;   /* open find handle, or 0 */
+    BOOL              complete; /* whole directory read */
+    unsigned          read;     /* directory entries read from the handle */
+    unsigned          count;
+    unsigned          size;
+    FIND_CACHE_ENTRY *entries;
+} FIND_CACHE;
+
+static FIND_CACHE INT21_FindCache[FIND_CACHE_SEARCHES];
+static unsigned   INT21_FindCacheNext;
+
+static void find_cache_free( FIND_CACHE *cache )
+{
+    if (cache->handle) FindClose( cache->handle );
+    HeapFree( GetProcessHeap(), 0, cache->entries );
+    memset( cache, 0, sizeof(*cache) );
+}
+
+/******************************************************************
+ *		INT21_FindRelease
+ *
+ * Free the directory listing of a search, before its fullPath is freed.
+ */
+static void INT21_FindRelease( const WCHAR *fullPath )
+{
+    unsigned i;
+
+    for (i = 0; i < FIND_CACHE_SEARCHES; i++)
+        if (INT21_FindCache[i].key == fullPath) find_cache_free( &INT21_FindCache[i] );
+}
+
+static BOOL find_cache_add( FIND_CACHE *cache, const WIN32_FIND_DATAW *data )
+{
+    static const WCHAR usersW[] = {'U','s','e','r','s',0};
+    static const WCHAR program_files_x86W[] = {'P','r','o','g','r','a','m',' ','F','i','l','e','s',' ','(','x','8','6',')',0};
+    static const WCHAR program_filesW[] = {'P','r','o','g','r','a','m',' ','F','i','l','e','s',0};
+    static const WCHAR program_dataW[] = {'P','r','o','g','r','a','m','D','a','t','a',0};
+    static const WCHAR windowsW[] = {'W','i','n','d','o','w','s',0};
+    static const WCHAR documentsW[] = {'D','o','c','u','m','e','n','t','s',' ','a','n','d',' ','S','e','t','t','i','n','g','s',0};
+    static const WCHAR *large_dirs[] =
+        { usersW, program_files_x86W, program_filesW, program_dataW, windowsW, documentsW };
+    const WCHAR *name = data->cAlternateFileName[0] ? data->cAlternateFileName : data->cFileName;
+    FIND_CACHE_ENTRY *entry;
+    int i;
+
+    /* a long name without a short one can't match any DOS mask */
+    if (strlenW( name ) > 12) return TRUE;
+
+    if (cache->count == cache->size)
+    {
+        unsigned size = cache->size ? cache->size * 2 : 64;
+        FIND_CACHE_ENTRY *entries;
+
+        if (cache->entries)
+            entries = HeapReAlloc( GetProcessHeap(), 0, cache->entries, size * sizeof(*entries) );
+        else
+            entries = HeapAlloc( GetProcessHeap(), 0, size * sizeof(*entries) );
+        if (!entries) return FALSE;
+        cache->entries = entries;
+        cache->size = size;
+    }
+    entry = &cache->entries[cache->count++];
+    entry->attr     = data->dwFileAttributes;
+    entry->size     = data->nFileSizeLow;
+    entry->creation = data->ftCreationTime;
+    entry->write    = data->ftLastWriteTime;
+    entry->flags    = INT21_ToDosFCBFormat( name, entry->fcb_name ) ? FIND_ENTRY_VALID : 0;
+    strcpyW( entry->name, name );
+    if (data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    {
+        for (i = 0; i < ARRAY_SIZE(large_dirs); i++)
+            if (!strcmpW( data->cFileName, large_dirs[i] )) entry->flags |= FIND_ENTRY_LARGE_DIR;
+    }
+    return TRUE;
+}
+
+/* open the find handle of a listing, and skip the entries already read */
+static BOOL find_cache_open( FIND_CACHE *cache, WIN32_FIND_DATAW *data )
+{
+    FIND_CACHE *other;
+    unsigned i;
+
+    for (i = 0; i < FIND_CACHE_SEARCHES; i++)
+    {
+        other = &INT21_FindCache[i];
+        if (!other->handle) continue;
+        while (FindNextFileW( other->handle, data ))
+        {
+            other->read++;
+            if (!find_cache_add( other, data )) break;
+        }
+        other->complete = (GetLastError() == ERROR_NO_MORE_FILES);
+        FindClose( other->handle );
+        other->handle = 0;
+    }
+    cache->handle = FindFirstFileW( cache->key, data );
+    if (cache->handle == INVALID_HANDLE_VALUE)
+    {
+        cache->handle = 0;
+        return FALSE;
+    }
+    for (i = 1; i < cache->read; i++)
+    {
+        if (!FindNextFileW( cache->handle, data ))
+        {
+            FindClose( cache->handle );
+            cache->handle = 0;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* get the listing of a search, starting a new one if needed */
+static FIND_CACHE *find_cache_get( LPCWSTR fullPath, unsigned count )
+{
+    WIN32_FIND_DATAW data;
+    FIND_CACHE *cache = NULL;
+    unsigned i;
+
+    for (i = 0; i < FIND_CACHE_SEARCHES; i++)
+    {
+        if (INT21_FindCache[i].key == fullPath)
+        {
+            cache = &INT21_FindCache[i];
+            if (count) return cache;
+            break;
+        }
+    }
+    if (!cache)
+    {
+        for (i = 0; i < FIND_CACHE_SEARCHES; i++)
+            if (!INT21_FindCache[i].key) break;
+        /* all in use, probably by searches that were never finished */
+        if (i == FIND_CACHE_SEARCHES) i = INT21_FindCacheNext++ % FIND_CACHE_SEARCHES;
+        cache = &INT21_FindCache[i];
+    }
+    find_cache_free( cache );
+
+    cache->key = fullPath;
+    if (!find_cache_open( cache, &data ) || !find_cache_add( cache, &data ))
+    {
+        find_cache_free( cache );
+        return NULL;
+    }
+    cache->read = 1;
+    return cache;
+}
+
+/* get an entry of a listing, reading the directory up to it */
+static const FIND_CACHE_ENTRY *find_cache_entry( FIND_CACHE *cache, unsigned index )
+{
+    WIN32_FIND_DATAW data;
+
+    while (index >= cache->count)
+    {
+        if (cache->complete) return NULL;
+        if (!cache->handle && !find_cache_open( cache, &data )) return NULL;
+        if (!FindNextFileW( cache->handle, &data ))
+        {
+            FindClose( cache->handle );
+            cache->handle = 0;
+            cache->complete = TRUE;
+            return NULL;
+        }
+        cache->read++;
+        if (!find_cache_add( cache, &data )) return NULL;
+    }
+    return &cache->entries[index];
+}
 
 /******************************************************************
  *		INT21_FindFirst
@@ -3925,15 +4118,12 @@ static BOOL INT21_FindFirst( CONTEXT *context )
 /******************************************************************
  *		match_short
  *
- * Check is a short path name (DTA unicode) matches a mask (FCB ansi)
+ * Check is a short name (FCB format) matches a mask (FCB format)
  */
-static BOOL match_short(LPCWSTR shortW, LPCSTR maskA)
+static BOOL match_short(const WCHAR *file, const WCHAR *mask)
 {
-    WCHAR mask[11], file[12];
     int i;
 
-    if (!INT21_ToDosFCBFormat( shortW, file )) return FALSE;
-    MultiByteToWideChar(CP_OEMCP, 0, maskA, 11, mask, 11);
     for (i = 0; i < 11; i++)
         if (mask[i] != '?' && mask[i] != file[i]) return FALSE;
     return TRUE;
@@ -3943,7 +4133,8 @@ static unsigned INT21_FindHelper(LPCWSTR fullPath, unsigned drive, unsigned coun
                                  LPCSTR mask, unsigned search_attr, 
                                  WIN32_FIND_DATAW* entry)
 {
-    unsigned ncalls;
+    FIND_CACHE *cache;
+    WCHAR maskW[11];
     const int attr_win32 = (-1 & ~(FA_NORMAL | FA_RDONLY | FA_HIDDEN | FA_SYSTEM | FA_LABEL | FA_DIRECTORY | FA_ARCHIVE | FA_UNUSED));
     const WCHAR croot[] = {'C',':','\\','*','.','*','\0'};
     char name[9] = {0};
@@ -3977,69 +4168,28 @@ static unsigned INT21_FindHelper(LPCWSTR fullPath, unsigned drive, unsigned coun
         return 1;
     }
 
-    if (!INT21_FindHandle || INT21_FindPath != fullPath || count == 0)
-    {
-        if (INT21_FindHandle) FindClose(INT21_FindHandle);
-        INT21_FindHandle = FindFirstFileW(fullPath, entry);
-        if (INT21_FindHandle == INVALID_HANDLE_VALUE)
-        {
-            INT21_FindHandle = 0;
-            return 0;
-        }
-        INT21_FindPath = fullPath;
-        /* we need to resync search */
-        ncalls = count;
-    }
-    else ncalls = 1;
+    if (!(cache = find_cache_get( fullPath, count ))) return 0;
+    MultiByteToWideChar(CP_OEMCP, 0, mask, 11, maskW, 11);
 
-    while (ncalls-- != 0)
+    for (; count < 0xffff; count++)
     {
-        if (!FindNextFileW(INT21_FindHandle, entry))
-        {
-            FindClose(INT21_FindHandle); INT21_FindHandle = 0;
-            return 0;
-        }
-    }
-    while (count < 0xffff)
-    {
-        if (skip_large && (entry->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-        {
-            const WCHAR *skip_dirs[] =
-                    {(const WCHAR []){'U','s','e','r','s','\0'},
-                     (const WCHAR []){'P','r','o','g','r','a','m',' ','F','i','l','e','s',' ','(','x','8','6',')','\0'},
-                     (const WCHAR []){'P','r','o','g','r','a','m',' ','F','i','l','e','s','\0'},
-                     (const WCHAR []){'P','r','o','g','r','a','m','D','a','t','a','\0'},
-                     (const WCHAR []){'W','i','n','d','o','w','s','\0'},
-                     (const WCHAR []){'D','o','c','u','m','e','n','t','s',' ','a','n','d',' ','S','e','t','t','i','n','g','s','\0'}};
-
-            for (int i = 0; i < ARRAY_SIZE(skip_dirs); i++)
-            {
-                if (!wcscmp(entry->cFileName, skip_dirs[i]))
-                {
-                    if (!FindNextFileW(INT21_FindHandle, entry))
-                    {
-                        FindClose(INT21_FindHandle); INT21_FindHandle = 0;
-                        return 0;
-                    }
-                    if (!(entry->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
-                        break;
-                    i = -1;
-                }
-            }
-        }
-        count++;
+        const FIND_CACHE_ENTRY *dir_entry = find_cache_entry( cache, count );
+
+        if (!dir_entry) return 0;
+        if (skip_large && (dir_entry->flags & FIND_ENTRY_LARGE_DIR)) continue;
         /* Check the file attributes, and path */
-        if (!(entry->dwFileAttributes & ~attr_win32 & ~search_attr) &&
-            match_short(entry->cAlternateFileName[0] ? entry->cAlternateFileName : entry->cFileName,
-                        mask))
-        {
-            entry->dwFileAttributes &= ~attr_win32;
-            return count;
-        }
-        if (!FindNextFileW(INT21_FindHandle, entry))
+        if (!(dir_entry->attr & ~attr_win32 & ~search_attr) &&
+            (dir_entry->flags & FIND_ENTRY_VALID) && match_short(dir_entry->fcb_name, maskW))
         {
-            FindClose(INT21_FindHandle); INT21_FindHandle = 0;
-            return 0;
+            entry->dwFileAttributes = dir_entry->attr & ~attr_win32;
+            entry->nFileSizeHigh    = 0;
+            entry->nFileSizeLow     = dir_entry->size;
+            entry->ftCreationTime   = dir_entry->creation;
+            entry->ftLastAccessTime = dir_entry->write;
+            entry->ftLastWriteTime  = dir_entry->write;
+            strcpyW( entry->cFileName, dir_entry->name );
+            strcpyW( entry->cAlternateFileName, dir_entry->name );
+            return count + 1;
         }
     }
     WARN("Too many directory entries in %s\n", debugstr_w(fullPath) );
@@ -4081,14 +4231,16 @@ static BOOL INT21_FindNext( CONTEXT *context )
              * be issued, and as a workaround in case file creation messes up
              * findnext, as sometimes happens with pkunzip
              */
+            INT21_FindRelease( dta->fullPath );
             HeapFree( GetProcessHeap(), 0, dta->fullPath );
-            INT21_FindPath = dta->fullPath = NULL;
+            dta->fullPath = NULL;
         }
         dta->count = n;
         return TRUE;
     }
+    INT21_FindRelease( dta->fullPath );
     HeapFree( GetProcessHeap(), 0, dta->fullPath );
-    INT21_FindPath = dta->fullPath = NULL;
+    dta->fullPath = NULL;
     return FALSE;
 }
 
@@ -4150,8 +4302,9 @@ static BOOL INT21_FindNextFCB( CONTEXT *context )
                          pFCB->count, pFCB->filename, attr, &entry);
     if (!n)
     {
+        INT21_FindRelease( pFCB->fullPath );
         HeapFree( GetProcessHeap(), 0, pFCB->fullPath );
-        INT21_FindPath = pFCB->fullPath = NULL;
+        pFCB->fullPath = NULL;
         return FALSE;
     }
     pFCB->count += n;
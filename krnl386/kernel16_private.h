@@ -526,6 +526,8 @@ typedef struct _NE_MODULE
     LPVOID    rsrc32_map;       /* HRSRC 16->32 map (for 32-bit modules) */
     LPCVOID   mapping;          /* mapping of the binary file */
     SIZE_T    mapping_size;     /* size of the file mapping */
+    LPVOID    name_index;       /* export name hash, built by NE_GetOrdinal */
+    LPVOID    res_index;        /* resource hash, built by FindResource16 */
 } NE_MODULE;
 
 typedef struct
@@ -689,6 +691,9 @@ extern void NE_InitializeDLLs( HMODULE16 hModule ) DECLSPEC_HIDDEN;
 extern void NE_DllProcessAttach( HMODULE16 hModule ) DECLSPEC_HIDDEN;
 extern void NE_CallUserSignalProc( HMODULE16 hModule, UINT16 code, WORD arg1, WORD arg2, WORD arg3 ) DECLSPEC_HIDDEN;
 
+/* resource.c */
+extern void NE_FreeResourceMaps( NE_MODULE *pModule ) DECLSPEC_HIDDEN;
+
 /* selector.c */
 extern WORD SELECTOR_AllocBlock( const void *base, DWORD size, unsigned char flags ) DECLSPEC_HIDDEN;
 extern WORD SELECTOR_ReallocBlock( WORD sel, const void *base, DWORD size ) DECLSPEC_HIDDEN;
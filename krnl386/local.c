@@ -911,7 +911,7 @@ static HLOCAL16 LOCAL_FindFreeBlock( HANDLE16 ds, WORD size, WORD flags )
     char *ptr = MapSL( MAKESEGPTR( ds, 0 ) );
     LOCALHEAPINFO *pInfo;
     LOCALARENA *pArena;
-    WORD arena, found = 0;
+    WORD arena;
 
     if (!(pInfo = LOCAL_GetHeap( ds )))
     {
@@ -920,18 +920,32 @@ static HLOCAL16 LOCAL_FindFreeBlock( HANDLE16 ds, WORD size, WORD flags )
 	return 0;
     }
 
+    if (flags & LMEM_MOVEABLE)
+    {
+        /* The free-list is sorted by address, so the last fit is the */
+        /* first one found walking back from the last arena. The big  */
+        /* free block is usually at the top of the heap.              */
+        arena = ARENA_PTR( ptr, pInfo->last )->free_prev;
+        pArena = ARENA_PTR( ptr, arena );
+        while (arena != pArena->free_prev)
+        {
+            if (pArena->size >= size) return arena;
+            arena = pArena->free_prev;
+            pArena = ARENA_PTR( ptr, arena );
+        }
+        TRACE("not enough space\n" );
+        LOCAL_PrintHeap(ds);
+        return 0;
+    }
+
     arena = pInfo->first;
     pArena = ARENA_PTR( ptr, arena );
     for (;;) {
         arena = pArena->free_next;
         pArena = ARENA_PTR( ptr, arena );
         if (arena == pArena->free_next) break;
-        if (pArena->size >= size) {
-            if (!(flags & LMEM_MOVEABLE)) return arena;
-            else found = arena;
-        }
+        if (pArena->size >= size) return arena;
     }
-    if (found) return found;
     TRACE("not enough space\n" );
     LOCAL_PrintHeap(ds);
     return 0;
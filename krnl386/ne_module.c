@@ -388,6 +388,92 @@ static void NE_InitResourceHandler( HMODULE16 hModule )
 }
 
 
+/* Hash of the resident and non-resident names, so that looking up an
+ * export by name doesn't walk both tables on every GetProcAddress16. */
+typedef struct
+{
+    DWORD hash;
+    WORD  offset;     /* offset of the name in its table, 0 if unused */
+    WORD  nonres;     /* name lives in the non-resident table */
+} NE_NAME_ENTRY;
+
+typedef struct
+{
+    UINT          mask;
+    NE_NAME_ENTRY entries[1];
+} NE_NAME_INDEX;
+
+static DWORD NE_HashName( const BYTE *name, BYTE len )
+{
+    DWORD hash = 2166136261u;
+    while (len--) hash = (hash ^ *name++) * 16777619u;
+    return hash;
+}
+
+static UINT NE_CountNames( const BYTE *cpnt )
+{
+    UINT count = 0;
+
+    cpnt += *cpnt + 1 + sizeof(WORD);
+    while (*cpnt)
+    {
+        count++;
+        cpnt += *cpnt + 1 + sizeof(WORD);
+    }
+    return count;
+}
+
+static void NE_IndexNames( NE_NAME_INDEX *index, const BYTE *table, WORD nonres )
+{
+    /* Skip the first entry (module name or description) */
+    const BYTE *cpnt = table + *table + 1 + sizeof(WORD);
+
+    while (*cpnt)
+    {
+        DWORD hash = NE_HashName( cpnt + 1, *cpnt );
+        UINT i = hash & index->mask;
+
+        /* Entries are never removed, so a name inserted later always sits
+         * further along the probe sequence: lookups find the first one. */
+        while (index->entries[i].offset) i = (i + 1) & index->mask;
+        index->entries[i].hash   = hash;
+        index->entries[i].offset = cpnt - table;
+        index->entries[i].nonres = nonres;
+        cpnt += *cpnt + 1 + sizeof(WORD);
+    }
+}
+
+/***********************************************************************
+ *           NE_BuildNameIndex
+ *
+ * Build the export name hash of a module on first use.
+ */
+static NE_NAME_INDEX *NE_BuildNameIndex( NE_MODULE *pModule )
+{
+    NE_NAME_INDEX *index;
+    const BYTE *nrtable = NULL;
+    UINT count, size = 16;
+
+    if (pModule->name_index) return pModule->name_index;
+
+    count = NE_CountNames( (BYTE *)pModule + pModule->ne_restab );
+    if (pModule->nrname_handle)
+    {
+        nrtable = GlobalLock16( pModule->nrname_handle );
+        count += NE_CountNames( nrtable );
+    }
+    while (size < count * 2) size <<= 1;
+
+    index = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                       FIELD_OFFSET( NE_NAME_INDEX, entries[size] ));
+    if (!index) return NULL;
+    index->mask = size - 1;
+    NE_IndexNames( index, (BYTE *)pModule + pModule->ne_restab, FALSE );
+    if (nrtable) NE_IndexNames( index, nrtable, TRUE );
+    pModule->name_index = index;
+    return index;
+}
+
 /***********************************************************************
  *           NE_GetOrdinal
  *
@@ -399,6 +485,7 @@ WORD NE_GetOrdinal( HMODULE16 hModule, const char *name )
     BYTE *cpnt;
     BYTE len;
     NE_MODULE *pModule;
+    NE_NAME_INDEX *index;
 
     if (!(pModule = NE_GetPtr( hModule ))) return 0;
     if (pModule->ne_flags & NE_FFLAGS_WIN32) return 0;
@@ -415,7 +502,34 @@ WORD NE_GetOrdinal( HMODULE16 hModule, const char *name )
     for (p = buffer; *p; p++) *p = RtlUpperChar(*p);
     len = p - buffer;
 
-      /* First search the resident names */
+      /* Look it up in the name hash, resident names first */
+
+    if ((index = NE_BuildNameIndex( pModule )))
+    {
+        DWORD hash = NE_HashName( (BYTE *)buffer, len );
+        const BYTE *restable = (BYTE *)pModule + pModule->ne_restab;
+        const BYTE *nrtable = NULL;
+        UINT i;
+
+        if (pModule->nrname_handle) nrtable = GlobalLock16( pModule->nrname_handle );
+        for (i = hash & index->mask; index->entries[i].offset; i = (i + 1) & index->mask)
+        {
+            const NE_NAME_ENTRY *entry = &index->entries[i];
+
+            if (entry->hash != hash) continue;
+            cpnt = (BYTE *)(entry->nonres ? nrtable : restable) + entry->offset;
+            if ((*cpnt == len) && !memcmp( cpnt+1, buffer, len ))
+            {
+                WORD ordinal;
+                memcpy( &ordinal, cpnt + *cpnt + 1, sizeof(ordinal) );
+                TRACE("  Found: ordinal=%d\n", ordinal );
+                return ordinal;
+            }
+        }
+        return 0;
+    }
+
+      /* No memory for the hash, search the resident names */
 
     cpnt = (BYTE *)pModule + pModule->ne_restab;
 
@@ -1683,6 +1797,9 @@ static BOOL16 NE_FreeModule( HMODULE16 hModule, BOOL call_wep, BOOL cleanup )
 
     /* Free the module storage */
 
+    HeapFree( GetProcessHeap(), 0, pModule->name_index );
+    pModule->name_index = NULL;
+    NE_FreeResourceMaps( pModule );
     GlobalFreeAll16( hModule );
     
     if (owner32)
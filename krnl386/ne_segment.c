@@ -133,13 +133,52 @@ static HFILE16 NE_OpenFile( NE_MODULE *pModule )
 }
 
 
+/* Entry points already resolved while loading a module, so that a target
+ * referenced by hundreds of relocation records is only looked up once. */
+#define IMPORT_CACHE_SIZE 1024
+
+struct import_cache
+{
+    DWORD     key[IMPORT_CACHE_SIZE];     /* MAKELONG(ordinal,module), 0 if unused */
+    FARPROC16 address[IMPORT_CACHE_SIZE];
+};
+
+/***********************************************************************
+ *           get_entry_point
+ *
+ * NE_GetEntryPoint going through the import cache, if any.
+ */
+static FARPROC16 get_entry_point( struct import_cache *cache, HMODULE16 module, WORD ordinal )
+{
+    DWORD key = MAKELONG( ordinal, module );
+    FARPROC16 address;
+    UINT i, probe;
+
+    if (!cache || !key) return NE_GetEntryPoint( module, ordinal );
+
+    i = (key * 2654435761u) >> 22;
+    for (probe = 0; probe < 8; probe++, i = (i + 1) % IMPORT_CACHE_SIZE)
+    {
+        if (cache->key[i] == key) return cache->address[i];
+        if (!cache->key[i]) break;
+    }
+    address = NE_GetEntryPoint( module, ordinal );
+    if (probe < 8)
+    {
+        cache->key[i] = key;
+        cache->address[i] = address;
+    }
+    return address;
+}
+
+
 /***********************************************************************
  *           apply_relocations
  *
  * Apply relocations to a segment. Helper for NE_LoadSegment.
  */
 static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocation_entry_s *rep,
-                                      int count, int segnum )
+                                      int count, int segnum, struct import_cache *cache )
 {
     BYTE *func_name;
     char buffer[256];
@@ -150,6 +189,8 @@ static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocatio
     HMODULE16 *pModuleTable = (HMODULE16 *)((char *)pModule + pModule->ne_modtab);
     SEGTABLEENTRY *pSegTable = NE_SEG_TABLE( pModule );
     SEGTABLEENTRY *pSeg = pSegTable + segnum - 1;
+    BYTE *base = MapSL( MAKESEGPTR( SEL(pSeg->hSeg), 0 ) );
+    DWORD limit = GlobalSize16( pSeg->hSeg );
 
     /*
      * Go through the relocation table one entry at a time.
@@ -168,7 +209,7 @@ static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocatio
         case NE_RELTYPE_ORDINAL:
             module = pModuleTable[rep->target1-1];
             ordinal = rep->target2;
-            address = NE_GetEntryPoint( module, ordinal );
+            address = get_entry_point( cache, module, ordinal );
             if (!address)
             {
                 NE_MODULE *pTarget = NE_GetPtr( module );
@@ -204,7 +245,7 @@ static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocatio
             memcpy( buffer, func_name+1, *func_name );
             buffer[*func_name] = '\0';
             ordinal = NE_GetOrdinal( module, buffer );
-            address = NE_GetEntryPoint( module, ordinal );
+            address = get_entry_point( cache, module, ordinal );
 
             if (ERR_ON(fixup) && !address)
             {
@@ -228,7 +269,7 @@ static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocatio
         case NE_RELTYPE_INTERNAL:
             if ((rep->target1 & 0xff) == 0xff)
             {
-                address  = NE_GetEntryPoint( pModule->self, rep->target2 );
+                address  = get_entry_point( cache, pModule->self, rep->target2 );
             }
             else
             {
@@ -270,7 +311,7 @@ static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocatio
 
         if (additive)
         {
-            sp = MapSL( MAKESEGPTR( SEL(pSeg->hSeg), offset ) );
+            sp = (WORD *)(base + offset);
             TRACE("    %04x:%04x\n", offset, *sp );
             switch (rep->address_type & 0x7f)
             {
@@ -301,7 +342,7 @@ static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocatio
             {
                 WORD next_offset;
 
-                sp = MapSL( MAKESEGPTR( SEL(pSeg->hSeg), offset ) );
+                sp = (WORD *)(base + offset);
                 next_offset = *sp;
                 TRACE("    %04x:%04x\n", offset, *sp );
                 switch (rep->address_type & 0x7f)
@@ -322,7 +363,7 @@ static inline BOOL apply_relocations( NE_MODULE *pModule, const struct relocatio
                     goto unknown;
                 }
                 if (next_offset == offset) break;  /* avoid infinite loop */
-                if (next_offset >= GlobalSize16(pSeg->hSeg)) break;
+                if (next_offset >= limit) break;
                 offset = next_offset;
             } while (offset != 0xffff);
         }
@@ -352,9 +393,9 @@ static void notify_load_seg(NE_MODULE *pModule, WORD segnum, SEGTABLEENTRY *pSeg
 }
 
 /***********************************************************************
- *           NE_LoadSegment
+ *           load_segment
  */
-BOOL NE_LoadSegment( NE_MODULE *pModule, WORD segnum )
+static BOOL load_segment( NE_MODULE *pModule, WORD segnum, struct import_cache *cache )
 {
     WORD count;
     DWORD pos;
@@ -471,7 +512,16 @@ BOOL NE_LoadSegment( NE_MODULE *pModule, WORD segnum )
     if (!(rep = NE_GET_DATA( pModule, pos, count * sizeof(struct relocation_entry_s) )))
         return FALSE;
 
-    return apply_relocations( pModule, rep, count, segnum );
+    return apply_relocations( pModule, rep, count, segnum, cache );
+}
+
+
+/***********************************************************************
+ *           NE_LoadSegment
+ */
+BOOL NE_LoadSegment( NE_MODULE *pModule, WORD segnum )
+{
+    return load_segment( pModule, segnum, NULL );
 }
 
 
@@ -526,8 +576,14 @@ BOOL NE_LoadAllSegments( NE_MODULE *pModule )
     }
     else
     {
+        /* segments are not moved while loading, so imports can be cached */
+        struct import_cache *cache = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) );
+        BOOL ret = TRUE;
+
         for (i = 1; i <= pModule->ne_cseg; i++)
-            if (!NE_LoadSegment( pModule, i )) return FALSE;
+            if (!(ret = load_segment( pModule, i, cache ))) break;
+        HeapFree( GetProcessHeap(), 0, cache );
+        return ret;
     }
     return TRUE;
 }
@@ -257,6 +257,19 @@ BOOL SNOOP16_ShowDebugmsgSnoop(const char *module, int ordinal, const char *func
 }
 
 
+/***********************************************************************
+ *           get_callfrom16
+ *
+ * Return the CALLFROM16 structure of the entry point being called.
+ */
+static inline const CALLFROM16 *get_callfrom16( STACK16FRAME *frame )
+{
+    BYTE *p = MapSL( MAKESEGPTR( frame->module_cs, frame->callfrom_ip ) );
+    /* p now points to lret, get the start of CALLFROM16 structure */
+    return (const CALLFROM16 *)(p - FIELD_OFFSET( CALLFROM16, ret ));
+}
+
+
 /***********************************************************************
  *           get_entry_point
  *
@@ -321,9 +334,7 @@ static const CALLFROM16 *get_entry_point( STACK16FRAME *frame, LPSTR module, LPS
 
     end:
     /* Retrieve entry point call structure */
-    p = MapSL( MAKESEGPTR( frame->module_cs, frame->callfrom_ip ) );
-    /* p now points to lret, get the start of CALLFROM16 structure */
-    return (CALLFROM16 *)(p - FIELD_OFFSET( CALLFROM16, ret ));
+    return get_callfrom16( frame );
 }
 #ifdef _MSC_VER
 extern int call_entry_point(void *func, int nb_args, const int *args)
@@ -505,6 +516,21 @@ int relay_call_from_16( void *entry_point, unsigned char *args16, CONTEXT *conte
     const CALLFROM16 *call;
 
     frame = CURRENT_STACK16;
+    if (!TRACE_ON(relay) && frame->module_cs != thunk32_relay_segment &&
+        NE_GetPtr( FarGetOwner16( GlobalHandle16( frame->module_cs ) ) ))
+    {
+        /* Built-in entry points push the argument conversion routine that */
+        /* convspec generated for their signature, use it directly instead */
+        /* of decoding arg_types. Thunks made by make_thunk_32 share a     */
+        /* template routine and always need the generic path.             */
+        call = get_callfrom16( frame );
+        if (call->relay == (void *)frame->relay && frame->relay != (DWORD)relay_call_from_16)
+        {
+            SYSLEVEL_CheckNotLevel( 2 );
+            return ((int (*)(void *, unsigned char *, CONTEXT *))call->relay)( entry_point, args16, context );
+        }
+        return relay_call_from_16_no_debug( entry_point, args16, context, call );
+    }
     call = get_entry_point( frame, module, func, &ordinal );
     if (!call)
     {
@@ -55,8 +55,9 @@ static inline NE_MODULE *get_module( HMODULE16 mod )
 
 typedef struct _HRSRC_ELEM
 {
-    HRSRC hRsrc;
-    WORD  type;
+    HRSRC  hRsrc;
+    WORD   type;
+    LPVOID bits16;   /* converted 16-bit menu or dialog */
 } HRSRC_ELEM;
 
 typedef struct _HRSRC_MAP
@@ -143,6 +144,18 @@ static WORD MapHRsrc16ToType( NE_MODULE *pModule, HRSRC16 hRsrc16 )
 }
 
 
+/**********************************************************************
+ *          MapHRsrc16ToElem
+ */
+static HRSRC_ELEM *MapHRsrc16ToElem( NE_MODULE *pModule, HRSRC16 hRsrc16 )
+{
+    HRSRC_MAP *map = pModule->rsrc32_map;
+    if ( !map || !hRsrc16 || hRsrc16 > map->nUsed ) return NULL;
+
+    return &map->elem[hRsrc16-1];
+}
+
+
 /**********************************************************************
  *          get_res_name
  *
@@ -329,6 +342,167 @@ static NE_NAMEINFO *NE_FindResourceFromType( LPBYTE pResTab, NE_TYPEINFO *pTypeI
 }
 
 
+/* Hash of (type, id) over the whole resource table, so that FindResource16
+ * does not walk every NE_TYPEINFO/NE_NAMEINFO and compare names each time. */
+typedef struct
+{
+    DWORD hash;
+    WORD  type;     /* offset of the NE_TYPEINFO from the module, 0 if unused */
+    WORD  rsrc;     /* offset of the NE_NAMEINFO from the module */
+} RES_INDEX_ENTRY;
+
+typedef struct
+{
+    UINT            shift;
+    UINT            mask;
+    BOOL            name_table;   /* module has a 0x800f name table */
+    RES_INDEX_ENTRY entries[1];
+} RES_INDEX;
+
+static inline DWORD res_hash_str( const BYTE *str, BYTE len )
+{
+    DWORD hash = 2166136261u;
+
+    /* same folding as strncasecmp in the C locale */
+    while (len--)
+    {
+        BYTE c = *str++;
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+/* hash of a type or name id as stored in the resource table */
+static inline DWORD res_hash_id( LPBYTE pResTab, WORD id )
+{
+    if (id & 0x8000) return id;
+    return res_hash_str( pResTab + id + 1, pResTab[id] );
+}
+
+/* hash of a type or name as passed to FindResource16 */
+static inline DWORD res_hash_name( LPCSTR name )
+{
+    if (!HIWORD(name)) return LOWORD(name) | 0x8000;
+    return res_hash_str( (const BYTE *)name, strlen( name ) );
+}
+
+static inline BOOL res_id_matches( LPBYTE pResTab, WORD id, LPCSTR name )
+{
+    if (HIWORD(name))
+    {
+        BYTE len = strlen( name );
+        return !(id & 0x8000) && pResTab[id] == len &&
+               !strncasecmp( (char *)pResTab + id + 1, name, len );
+    }
+    return id == (LOWORD(name) | 0x8000);
+}
+
+static inline UINT res_index_slot( const RES_INDEX *index, DWORD hash )
+{
+    return (hash * 2654435761u) >> index->shift;
+}
+
+/***********************************************************************
+ *           NE_GetResourceIndex
+ *
+ * Build the resource hash of a module on first use. Resources are
+ * inserted in table order and never removed, so the first match along
+ * a probe sequence is the one the linear search would return.
+ */
+static RES_INDEX *NE_GetResourceIndex( NE_MODULE *pModule )
+{
+    LPBYTE pResTab = (LPBYTE)pModule + pModule->ne_rsrctab;
+    NE_TYPEINFO *pTypeInfo;
+    NE_NAMEINFO *pNameInfo;
+    RES_INDEX *index;
+    UINT count = 0, bits = 4;
+    int i;
+
+    if (pModule->res_index) return pModule->res_index;
+
+    for (pTypeInfo = (NE_TYPEINFO *)(pResTab + 2); pTypeInfo->type_id;
+         pTypeInfo = next_typeinfo(pTypeInfo))
+        count += pTypeInfo->count;
+    while ((1u << bits) < count * 2) bits++;
+
+    index = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                       FIELD_OFFSET( RES_INDEX, entries[1 << bits] ));
+    if (!index) return NULL;
+    index->shift = 32 - bits;
+    index->mask  = (1 << bits) - 1;
+
+    for (pTypeInfo = (NE_TYPEINFO *)(pResTab + 2); pTypeInfo->type_id;
+         pTypeInfo = next_typeinfo(pTypeInfo))
+    {
+        DWORD type_hash = res_hash_id( pResTab, pTypeInfo->type_id );
+
+        if (pTypeInfo->type_id == 0x800f) index->name_table = TRUE;
+        pNameInfo = (NE_NAMEINFO *)(pTypeInfo + 1);
+        for (i = pTypeInfo->count; i > 0; i--, pNameInfo++)
+        {
+            DWORD hash = type_hash * 31 + res_hash_id( pResTab, pNameInfo->id );
+            UINT slot = res_index_slot( index, hash );
+
+            while (index->entries[slot].type) slot = (slot + 1) & index->mask;
+            index->entries[slot].hash = hash;
+            index->entries[slot].type = (char *)pTypeInfo - (char *)pModule;
+            index->entries[slot].rsrc = (char *)pNameInfo - (char *)pModule;
+        }
+    }
+    pModule->res_index = index;
+    return index;
+}
+
+/***********************************************************************
+ *           NE_FindResourceIndexed
+ *
+ * Find a resource through the module resource hash.
+ */
+static HRSRC16 NE_FindResourceIndexed( NE_MODULE *pModule, RES_INDEX *index,
+                                       LPCSTR typeId, LPCSTR resId )
+{
+    LPBYTE pResTab = (LPBYTE)pModule + pModule->ne_rsrctab;
+    DWORD hash = res_hash_name( typeId ) * 31 + res_hash_name( resId );
+    UINT slot;
+
+    for (slot = res_index_slot( index, hash ); index->entries[slot].type;
+         slot = (slot + 1) & index->mask)
+    {
+        const RES_INDEX_ENTRY *entry = &index->entries[slot];
+        NE_TYPEINFO *pTypeInfo;
+        NE_NAMEINFO *pNameInfo;
+
+        if (entry->hash != hash) continue;
+        pTypeInfo = (NE_TYPEINFO *)((char *)pModule + entry->type);
+        pNameInfo = (NE_NAMEINFO *)((char *)pModule + entry->rsrc);
+        if (res_id_matches( pResTab, pTypeInfo->type_id, typeId ) &&
+            res_id_matches( pResTab, pNameInfo->id, resId ))
+            return entry->rsrc;
+    }
+    return 0;
+}
+
+/***********************************************************************
+ *           NE_FreeResourceMaps
+ *
+ * Free the resource hash and the HRSRC map of a module.
+ */
+void NE_FreeResourceMaps( NE_MODULE *pModule )
+{
+    HRSRC_MAP *map = pModule->rsrc32_map;
+    int i;
+
+    HeapFree( GetProcessHeap(), 0, pModule->res_index );
+    pModule->res_index = NULL;
+    if (!map) return;
+    for (i = 0; i < map->nUsed; i++) HeapFree( GetProcessHeap(), 0, map->elem[i].bits16 );
+    HeapFree( GetProcessHeap(), 0, map->elem );
+    HeapFree( GetProcessHeap(), 0, map );
+    pModule->rsrc32_map = NULL;
+}
+
+
 /***********************************************************************
  *           DefResourceHandler (KERNEL.456)
  *
@@ -837,31 +1011,46 @@ static void ConvertAccelerator32To16( LPCVOID acc32, DWORD size, LPVOID acc16 )
 
 /**********************************************************************
  *	    NE_LoadPEResource
+ *
+ * Converted menus and dialogs are kept in the HRSRC map, so that loading
+ * the same template again only copies it.
  */
-static HGLOBAL16 NE_LoadPEResource( NE_MODULE *pModule, WORD type, LPCVOID bits, DWORD size )
+static HGLOBAL16 NE_LoadPEResource( NE_MODULE *pModule, HRSRC16 hRsrc, WORD type, LPCVOID bits, DWORD size )
 {
     HGLOBAL16 handle;
+    HRSRC_ELEM *elem;
+    LPVOID mem;
 
     TRACE("module=%04x type=%04x\n", pModule->self, type );
 
-    handle = GlobalAlloc16( 0, size );
+    if (!(handle = GlobalAlloc16( 0, size ))) return 0;
+    mem = GlobalLock16( handle );
 
     switch (type)
     {
     case (WORD)RT_MENU:
-        ConvertMenu32To16( bits, size, GlobalLock16( handle ) );
-        break;
     case (WORD)RT_DIALOG:
-        ConvertDialog32To16( bits, size, GlobalLock16( handle ) );
+        elem = MapHRsrc16ToElem( pModule, hRsrc );
+        if (elem && elem->bits16)
+        {
+            memcpy( mem, elem->bits16, size );
+            break;
+        }
+        if (type == (WORD)RT_MENU)
+            ConvertMenu32To16( bits, size, mem );
+        else
+            ConvertDialog32To16( bits, size, mem );
+        if (elem && (elem->bits16 = HeapAlloc( GetProcessHeap(), 0, size )))
+            memcpy( elem->bits16, mem, size );
         break;
     case (WORD)RT_ACCELERATOR:
-        ConvertAccelerator32To16( bits, size, GlobalLock16( handle ) );
+        ConvertAccelerator32To16( bits, size, mem );
         break;
     case (WORD)RT_STRING:
         FIXME("not yet implemented!\n" );
         /* fall through */
     default:
-        memcpy( GlobalLock16( handle ), bits, size );
+        memcpy( mem, bits, size );
         break;
     }
     return handle;
@@ -942,6 +1131,7 @@ HRSRC16 WINAPI FindResource16( HMODULE16 hModule, LPCSTR name, LPCSTR type )
     NE_TYPEINFO *pTypeInfo;
     NE_NAMEINFO *pNameInfo;
     LPBYTE pResTab;
+    RES_INDEX *index;
     NE_MODULE *pModule = get_module( hModule );
 
     if (!pModule) return 0;
@@ -961,8 +1151,9 @@ HRSRC16 WINAPI FindResource16( HMODULE16 hModule, LPCSTR name, LPCSTR type )
 
     type = get_res_name( type );
     name = get_res_name( name );
+    index = NE_GetResourceIndex( pModule );
 
-    if (HIWORD(type) || HIWORD(name))
+    if ((HIWORD(type) || HIWORD(name)) && (!index || index->name_table))
     {
         DWORD id = NE_FindNameTableId( pModule, type, name );
         if (id)  /* found */
@@ -971,6 +1162,13 @@ HRSRC16 WINAPI FindResource16( HMODULE16 hModule, LPCSTR name, LPCSTR type )
             name = (LPCSTR)(ULONG_PTR)HIWORD(id);
         }
     }
+    if (index)
+    {
+        HRSRC16 hRsrc = NE_FindResourceIndexed( pModule, index, type, name );
+        if (hRsrc) TRACE("    Found id %p\n", name );
+        return hRsrc;
+    }
+
     pResTab = (LPBYTE)pModule + pModule->ne_rsrctab;
     pTypeInfo = (NE_TYPEINFO *)( pResTab + 2 );
 
@@ -1019,7 +1217,7 @@ HGLOBAL16 WINAPI LoadResource16( HMODULE16 hModule, HRSRC16 hRsrc )
         HGLOBAL hMem  = LoadResource( m32, hRsrc32 );
         DWORD size    = SizeofResource( m32, hRsrc32 );
         if (!hMem) return 0;
-        return NE_LoadPEResource( pModule, type, LockResource( hMem ), size );
+        return NE_LoadPEResource( pModule, hRsrc, type, LockResource( hMem ), size );
     }
 
     /* first, verify hRsrc (just an offset from pModule to the needed pNameInfo) */
@@ -445,13 +445,61 @@ BOOL16 WINAPI IsBadFlatReadWritePtr16( SEGPTR ptr, DWORD size, BOOL16 bWrite )
 
 struct mapls_entry
 {
-    struct mapls_entry *next;
+    struct mapls_entry *next;       /* next entry in the same hash bucket */
+    struct mapls_entry *lru_prev;   /* unused entries, least recently released first */
+    struct mapls_entry *lru_next;
     void               *addr;   /* linear address */
     int                 count;  /* ref count */
     WORD                sel;    /* selector */
 };
 
-static struct mapls_entry *first_entry;
+#define MAPLS_HASH_SIZE 1024
+
+/* tiles are 32K aligned, hash on the tile number */
+#define MAPLS_HASH(base) (((ULONG_PTR)(base) >> 15) % MAPLS_HASH_SIZE)
+
+static struct mapls_entry *mapls_hash[MAPLS_HASH_SIZE];
+static struct mapls_entry *mapls_sel[LDT_SIZE];
+static struct mapls_entry mapls_lru = { NULL, &mapls_lru, &mapls_lru };
+
+static CRITICAL_SECTION mapls_section;
+static CRITICAL_SECTION_DEBUG mapls_critsect_debug =
+{
+    0, 0, &mapls_section,
+    { &mapls_critsect_debug.ProcessLocksList, &mapls_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": mapls_section") }
+};
+static CRITICAL_SECTION mapls_section = { &mapls_critsect_debug, -1, 0, 0, 0, 0 };
+
+static void mapls_lru_remove( struct mapls_entry *entry )
+{
+    entry->lru_prev->lru_next = entry->lru_next;
+    entry->lru_next->lru_prev = entry->lru_prev;
+}
+
+static void mapls_lru_append( struct mapls_entry *entry )
+{
+    entry->lru_prev = mapls_lru.lru_prev;
+    entry->lru_next = &mapls_lru;
+    mapls_lru.lru_prev->lru_next = entry;
+    mapls_lru.lru_prev = entry;
+}
+
+static void mapls_hash_remove( struct mapls_entry *entry )
+{
+    struct mapls_entry **p = &mapls_hash[MAPLS_HASH(entry->addr)];
+
+    while (*p != entry) p = &(*p)->next;
+    *p = entry->next;
+}
+
+static void mapls_hash_insert( struct mapls_entry *entry )
+{
+    struct mapls_entry **p = &mapls_hash[MAPLS_HASH(entry->addr)];
+
+    entry->next = *p;
+    *p = entry;
+}
 
 
 /***********************************************************************
@@ -462,45 +510,48 @@ static struct mapls_entry *first_entry;
  */
 SEGPTR WINAPI MapLS( LPCVOID ptr )
 {
-    struct mapls_entry *entry, *free = NULL;
+    struct mapls_entry *entry;
     const void *base;
     SEGPTR ret = 0;
 
     if (!HIWORD(ptr)) return (SEGPTR)LOWORD(ptr);
 
     base = (const char *)ptr - ((ULONG_PTR)ptr & 0x7fff);
-    HeapLock( GetProcessHeap() );
-    for (entry = first_entry; entry; entry = entry->next)
-    {
+    EnterCriticalSection( &mapls_section );
+    for (entry = mapls_hash[MAPLS_HASH(base)]; entry; entry = entry->next)
         if (entry->addr == base) break;
-        if (!entry->count) free = entry;
-    }
 
     if (!entry)
     {
         LDT_ENTRY ldt;
-        if (!free)  /* no free entry found, create a new one */
+        if (mapls_lru.lru_next != &mapls_lru)  /* reuse the least recently released tile */
+        {
+            entry = mapls_lru.lru_next;
+            mapls_lru_remove( entry );
+            mapls_hash_remove( entry );
+        }
+        else  /* no free entry found, create a new one */
         {
-            if (!(free = HeapAlloc( GetProcessHeap(), 0, sizeof(*free) ))) goto done;
-            if (!(free->sel = SELECTOR_AllocBlock( base, 0x10000, WINE_LDT_FLAGS_DATA )))
+            if (!(entry = HeapAlloc( GetProcessHeap(), 0, sizeof(*entry) ))) goto done;
+            if (!(entry->sel = SELECTOR_AllocBlock( base, 0x10000, WINE_LDT_FLAGS_DATA )))
             {
-                HeapFree( GetProcessHeap(), 0, free );
+                HeapFree( GetProcessHeap(), 0, entry );
                 goto done;
             }
-            free->count = 0;
-            free->next = first_entry;
-            first_entry = free;
+            entry->count = 0;
+            mapls_sel[entry->sel >> __AHSHIFT] = entry;
         }
-        wine_ldt_get_entry(free->sel, &ldt);
+        wine_ldt_get_entry(entry->sel, &ldt);
         wine_ldt_set_base(&ldt, (DWORD)base);
-        wine_ldt_set_entry(free->sel, &ldt);
-        free->addr = (void*)base;
-        entry = free;
+        wine_ldt_set_entry(entry->sel, &ldt);
+        entry->addr = (void*)base;
+        mapls_hash_insert( entry );
     }
+    else if (!entry->count) mapls_lru_remove( entry );
     entry->count++;
     ret = MAKESEGPTR( entry->sel, (const char *)ptr - (char *)entry->addr );
  done:
-    HeapUnlock( GetProcessHeap() );
+    LeaveCriticalSection( &mapls_section );
     return ret;
 }
 
@@ -517,10 +568,14 @@ void WINAPI UnMapLS( SEGPTR sptr )
 
     if (sel)
     {
-        HeapLock( GetProcessHeap() );
-        for (entry = first_entry; entry; entry = entry->next) if (entry->sel == sel) break;
-        if (entry && entry->count > 0) entry->count--;
-        HeapUnlock( GetProcessHeap() );
+        EnterCriticalSection( &mapls_section );
+        entry = mapls_sel[sel >> __AHSHIFT];
+        if (entry && entry->sel == sel && entry->count > 0)
+        {
+            /* the tile stays mapped until it is reused for another base */
+            if (!--entry->count) mapls_lru_append( entry );
+        }
+        LeaveCriticalSection( &mapls_section );
     }
 }
 
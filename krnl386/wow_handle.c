@@ -32,7 +32,23 @@ typedef struct
     HMENU16 hMenu16;
     void *ptr;
     WOW_HANDLE_TYPE type;
+    /* handle32 is a live mapping (registered in the index) */
+    BOOL live;
 } HANDLE_DATA;
+/*
+free slots, one bit per handle16.
+summary bit n is set if bits[n] is not zero.
+*/
+typedef struct
+{
+    DWORD summary[65536 / 32 / 32];
+    DWORD bits[65536 / 32];
+} HANDLE_FREE_MAP;
+/* free_map[0]: unused slots, free_map[n]: slots released by a GDI object of type n */
+#define HANDLE_FREE_TYPES 16
+/* handle32 -> handle16 open addressing hash (linear probing, 0 = empty) */
+#define HANDLE_INDEX_SIZE 0x20000
+#define HANDLE_INDEX_MASK (HANDLE_INDEX_SIZE - 1)
 typedef struct tagHANDLE_STORAGE *LPHANDLE_STORAGE;
 typedef void(*clean_up_t)(LPHANDLE_STORAGE);
 typedef struct
@@ -42,6 +58,12 @@ typedef struct
     int align;
     int align2;
     clean_up_t clean_up;
+    WORD *index;
+    /* live slots that share their handle32 with the lower slot in the index */
+    WORD *aliases;
+    int alias_count;
+    int alias_size;
+    HANDLE_FREE_MAP *free_map[HANDLE_FREE_TYPES];
 } HANDLE_STORAGE;
 #define HANDLE_TYPE_HANDLE 0
 #define HANDLE_TYPE_HGDI 1
@@ -54,6 +76,244 @@ static void user_handle_clean_up(HANDLE_STORAGE* hs);
 static BOOL map_low_word_user_handle;
 static CRITICAL_SECTION handle_lock;
 
+static BOOL is_handle_slot(const HANDLE_STORAGE *hs, WORD i)
+{
+    if (i < HANDLE_RESERVED || i >= (WORD)(-HANDLE_RESERVED))
+        return FALSE;
+    if (i % hs->align)
+        return FALSE;
+    if (hs->align2 && (i & -hs->align2) == i)
+        return FALSE;
+    return TRUE;
+}
+
+static int lowest_bit(DWORD v)
+{
+    int b = 0;
+    while (!(v & 1))
+    {
+        v >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void free_map_set(HANDLE_FREE_MAP *map, WORD i)
+{
+    map->bits[i / 32] |= 1u << (i % 32);
+    map->summary[i / 1024] |= 1u << (i / 32 % 32);
+}
+
+static void free_map_clear(HANDLE_FREE_MAP *map, WORD i)
+{
+    map->bits[i / 32] &= ~(1u << (i % 32));
+    if (!map->bits[i / 32])
+        map->summary[i / 1024] &= ~(1u << (i / 32 % 32));
+}
+
+/* lowest free slot or 0 */
+static WORD free_map_first(const HANDLE_FREE_MAP *map)
+{
+    if (!map)
+        return 0;
+    for (int j = 0; j < ARRAY_SIZE(map->summary); j++)
+    {
+        if (map->summary[j])
+        {
+            int w = j * 32 + lowest_bit(map->summary[j]);
+            return w * 32 + lowest_bit(map->bits[w]);
+        }
+    }
+    return 0;
+}
+
+/* free map for the slot value of an unused (0) or released (GDI type << 16) slot */
+static HANDLE_FREE_MAP *get_free_map(HANDLE_STORAGE *hs, DWORD value, BOOL create)
+{
+    DWORD type = value >> 16;
+    if ((value & 0xffff) || type >= HANDLE_FREE_TYPES)
+        return NULL;
+    if (!hs->free_map[type] && create)
+        hs->free_map[type] = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(HANDLE_FREE_MAP));
+    return hs->free_map[type];
+}
+
+static DWORD handle_hash(HANDLE h)
+{
+    DWORD v = (DWORD)(ULONG_PTR)h;
+    return ((v ^ (v >> 16)) * 2654435761u) >> (32 - 17);
+}
+
+static DWORD handle_index_find(HANDLE_STORAGE *hs, HANDLE h)
+{
+    DWORD pos;
+    for (pos = handle_hash(h); hs->index[pos]; pos = (pos + 1) & HANDLE_INDEX_MASK)
+    {
+        if (hs->handles[hs->index[pos]].handle32 == h)
+            break;
+    }
+    return pos;
+}
+
+static void alias_add(HANDLE_STORAGE *hs, WORD i)
+{
+    if (hs->alias_count == hs->alias_size)
+    {
+        int size = hs->alias_size ? hs->alias_size * 2 : 16;
+        WORD *aliases;
+        if (hs->aliases)
+            aliases = HeapReAlloc(GetProcessHeap(), 0, hs->aliases, size * sizeof(WORD));
+        else
+            aliases = HeapAlloc(GetProcessHeap(), 0, size * sizeof(WORD));
+        if (!aliases)
+        {
+            ERR("out of memory\n");
+            return;
+        }
+        hs->aliases = aliases;
+        hs->alias_size = size;
+    }
+    hs->aliases[hs->alias_count++] = i;
+}
+
+/* remove the alias at position n of the alias list */
+static void alias_remove(HANDLE_STORAGE *hs, int n)
+{
+    hs->aliases[n] = hs->aliases[--hs->alias_count];
+}
+
+static void handle_index_insert(HANDLE_STORAGE *hs, WORD i)
+{
+    DWORD pos = handle_index_find(hs, hs->handles[i].handle32);
+    if (hs->index[pos])
+    {
+        /* the same handle32 in two slots: lookups return the lower one */
+        if (i < hs->index[pos])
+        {
+            alias_add(hs, hs->index[pos]);
+            hs->index[pos] = i;
+        }
+        else
+            alias_add(hs, i);
+        return;
+    }
+    hs->index[pos] = i;
+}
+
+static void handle_index_remove(HANDLE_STORAGE *hs, WORD i)
+{
+    HANDLE h = hs->handles[i].handle32;
+    DWORD pos = handle_index_find(hs, h);
+    DWORD next = pos;
+    int n, lowest = -1;
+    if (hs->index[pos] != i)
+    {
+        for (n = 0; n < hs->alias_count; n++)
+        {
+            if (hs->aliases[n] == i)
+            {
+                alias_remove(hs, n);
+                break;
+            }
+        }
+        return;
+    }
+    /* the lowest alias of h takes over the index entry */
+    for (n = 0; n < hs->alias_count; n++)
+    {
+        if (hs->handles[hs->aliases[n]].handle32 == h && (lowest < 0 || hs->aliases[n] < hs->aliases[lowest]))
+            lowest = n;
+    }
+    if (lowest >= 0)
+    {
+        hs->index[pos] = hs->aliases[lowest];
+        alias_remove(hs, lowest);
+        return;
+    }
+    /* backward shift deletion */
+    for (;;)
+    {
+        WORD slot;
+        DWORD home;
+        next = (next + 1) & HANDLE_INDEX_MASK;
+        slot = hs->index[next];
+        if (!slot)
+            break;
+        home = handle_hash(hs->handles[slot].handle32);
+        if (((next - home) & HANDLE_INDEX_MASK) >= ((next - pos) & HANDLE_INDEX_MASK))
+        {
+            hs->index[pos] = slot;
+            pos = next;
+        }
+    }
+    hs->index[pos] = 0;
+}
+
+/* detach slot i from the index or its free map */
+static void unlink_handle_slot(HANDLE_STORAGE *hs, WORD i)
+{
+    if (hs->handles[i].live)
+    {
+        handle_index_remove(hs, i);
+        hs->handles[i].live = FALSE;
+    }
+    else
+    {
+        HANDLE_FREE_MAP *map = get_free_map(hs, (DWORD)(ULONG_PTR)hs->handles[i].handle32, FALSE);
+        if (map)
+            free_map_clear(map, i);
+    }
+}
+
+/* map slot i to h, clear resets the per-handle data */
+static void claim_handle_slot(HANDLE_STORAGE *hs, WORD i, HANDLE h, BOOL clear)
+{
+    if (!is_handle_slot(hs, i))
+    {
+        if (clear)
+            memset(hs->handles + i, 0, sizeof(*hs->handles));
+        hs->handles[i].handle32 = h;
+        return;
+    }
+    unlink_handle_slot(hs, i);
+    if (clear)
+        memset(hs->handles + i, 0, sizeof(*hs->handles));
+    hs->handles[i].handle32 = h;
+    hs->handles[i].live = TRUE;
+    handle_index_insert(hs, i);
+}
+
+/* clear slot i, type is the GetObjectType of the released object (HGDI only) */
+static void release_handle_slot(HANDLE_STORAGE *hs, WORD i, DWORD type)
+{
+    HANDLE_FREE_MAP *map;
+    if (!is_handle_slot(hs, i))
+    {
+        memset(hs->handles + i, 0, sizeof(*hs->handles));
+        hs->handles[i].handle32 = (HANDLE)(ULONG_PTR)type;
+        return;
+    }
+    unlink_handle_slot(hs, i);
+    memset(hs->handles + i, 0, sizeof(*hs->handles));
+    hs->handles[i].handle32 = (HANDLE)(ULONG_PTR)type;
+    map = get_free_map(hs, type, TRUE);
+    if (map)
+        free_map_set(map, i);
+}
+
+static void init_handle_storage(HANDLE_STORAGE *hs)
+{
+    HANDLE_FREE_MAP *map;
+    hs->handles = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 65536 * sizeof(HANDLE_DATA));
+    hs->index = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, HANDLE_INDEX_SIZE * sizeof(WORD));
+    map = get_free_map(hs, 0, TRUE);
+    for (int i = HANDLE_RESERVED; i < (WORD)(-HANDLE_RESERVED); i += hs->align)
+    {
+        if (is_handle_slot(hs, i))
+            free_map_set(map, i);
+    }
+}
+
 /* this function called by DllMain(kernel.c) */
 void init_wow_handle()
 {
@@ -61,12 +321,12 @@ void init_wow_handle()
         return;
     handle_trace = TRACE_ON(thunk);
     handle_init_flag = TRUE;
-    handle_list[HANDLE_TYPE_HANDLE].handles = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 65536 * sizeof(HANDLE_DATA));
     handle_list[HANDLE_TYPE_HANDLE].align = 1;
     /* IsWindow(hdc) should return FALSE */
     handle_list[HANDLE_TYPE_HANDLE].align2 = 4;
     handle_list[HANDLE_TYPE_HANDLE].name = "HANDLE";
     handle_list[HANDLE_TYPE_HANDLE].clean_up = user_handle_clean_up;
+    init_handle_storage(&handle_list[HANDLE_TYPE_HANDLE]);
     /*
     hdc1 = CreateCompatibleDC(0);
     hdc2 = CreateCompatibleDC(0);
@@ -79,8 +339,8 @@ void init_wow_handle()
     handle_list[HANDLE_TYPE_HGDI].align = 4;
     handle_list[HANDLE_TYPE_HGDI].name = "HGDI";
     handle_list[HANDLE_TYPE_HGDI].align2 = 0;
-    handle_list[HANDLE_TYPE_HGDI].handles = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 65536 * sizeof(HANDLE_DATA));
     handle_list[HANDLE_TYPE_HGDI].clean_up = hgdi_clean_up;
+    init_handle_storage(&handle_list[HANDLE_TYPE_HGDI]);
     map_low_word_user_handle = krnl386_get_config_int("otvdm", "MapLowWordUserHandle", FALSE);
     InitializeCriticalSection(&handle_lock);
 }
@@ -134,27 +394,25 @@ WORD get_handle16_data(HANDLE h, HANDLE_STORAGE *hs, HANDLE_DATA **o)
 		*o = &hs->handles[(size_t)h];
 		return h;
 	}
-	WORD fhandle = 0;
+	WORD fhandle;
+    WORD found;
     DWORD type = get_handle_type(h, hs);
 
-    WORD s = HANDLE_RESERVED;
 retry:
-	for (WORD i = s; i; i += hs->align)
-	{
-        if (i >= (WORD)(-HANDLE_RESERVED))
-            break;
-        if (hs->align2 && (i & -hs->align2) == i)
-            continue;
-		if ((!hs->handles[i].handle32 || (hs->handles[i].handle32 == type)) && !fhandle)
-		{
-			fhandle = i;
-		}
-		if (hs->handles[i].handle32 == h)
-		{
-			*o = &hs->handles[i];
-			return i;
-		}
-	}
+    found = hs->index[handle_index_find(hs, h)];
+    if (found)
+    {
+        *o = &hs->handles[found];
+        return found;
+    }
+    /* lowest unused slot or slot released by the same GDI object type */
+    fhandle = free_map_first(hs->free_map[0]);
+    if (type)
+    {
+        WORD t = free_map_first(get_free_map(hs, type, FALSE));
+        if (t && (!fhandle || t < fhandle))
+            fhandle = t;
+    }
 	if (!fhandle)
 	{
         *o = NULL;
@@ -170,7 +428,7 @@ retry:
     if (handle_trace)
         DPRINTF("allocate %s %p=>%04x\n", hs->name, h, fhandle);
 	*o = &hs->handles[fhandle];
-    memset(*o, 0, sizeof(HANDLE_DATA));
+    claim_handle_slot(hs, fhandle, h, TRUE);
 	return fhandle;
 }
 void destroy_handle16(HANDLE_STORAGE *hs, WORD h)
@@ -180,8 +438,7 @@ void destroy_handle16(HANDLE_STORAGE *hs, WORD h)
         return;
     }
     DWORD type = get_handle_type(hs->handles[h].handle32, hs);
-    memset(hs->handles + h, 0, sizeof(*hs->handles));
-    hs->handles[h].handle32 = type;
+    release_handle_slot(hs, h, type);
 }
 BOOL get_handle32_data(WORD h, HANDLE_STORAGE *hs, HANDLE_DATA **o)
 {
@@ -210,7 +467,7 @@ HANDLE get_handle32(WORD h, HANDLE_STORAGE *hs)
     {
         return hs->handles[h].handle32;
     }
-    hs->handles[h].handle32 = h;
+    claim_handle_slot(hs, h, (HANDLE)h, FALSE);
     return (HANDLE)h;
 }
 
@@ -357,6 +614,13 @@ static void hgdi_clean_up(HANDLE_STORAGE* hs)
 {
     for (int i = HANDLE_RESERVED; i < (WORD)(-HANDLE_RESERVED); i += hs->align)
     {
+        if (!hs->handles[i].live)
+        {
+            /* released slots become usable by any object type */
+            if (hs->handles[i].handle32)
+                release_handle_slot(hs, i, 0);
+            continue;
+        }
         if (handle_trace)
         {
             static const char *tbl[] =
@@ -387,6 +651,8 @@ static void user_handle_clean_up(HANDLE_STORAGE* hs)
 {
     for (int i = HANDLE_RESERVED; i < (WORD)(-HANDLE_RESERVED); i += hs->align)
     {
+        if (!hs->handles[i].live)
+            continue;
         K32WOWHandle16DestroyHint(hs->handles[i].handle32, hs->handles[i].type);
     }
 }
@@ -619,12 +619,13 @@ BOOL WINAPI K32WOWCallback16Ex( DWORD vpfn16, DWORD dwFlags,
     /*
      * Arguments must be prepared in the correct order by the caller
      * (both for PASCAL and CDECL calling convention), so we simply
-     * copy them to the 16-bit stack ...
+     * copy them to the 16-bit stack ... unless the caller already
+     * built them there, at CURRENT_STACK16 - cbArgs.
      */
     char *stack = (char *)CURRENT_STACK16 - cbArgs;
     LPVOID old = getWOW32Reserved();
 
-    memcpy( stack, pArgs, cbArgs );
+    if (pArgs != stack) memcpy( stack, pArgs, cbArgs );
 
     if (dwFlags & (WCB16_REGS|WCB16_REGS_LONG))
     {
@@ -29,6 +29,7 @@ copy (Join-Path $src "haxmvm.dll") $dll -ErrorAction SilentlyContinue > $null
 copy (Join-Path $src "gvm.dll") $dll -ErrorAction SilentlyContinue > $null
 copy (Join-Path $src "whpxvm.dll") $dll -ErrorAction SilentlyContinue > $null
 copy (Join-Path $src "vm86.dll") $dll
+copy (Join-Path $src "vm86tc.dll") $dll
 copy (Join-Path $src "wow32.dll") $dll
 copy (Join-Path $src "libwine.dll") $dst
 mkdir (Join-Path $dst "WINDOWS") -ErrorAction SilentlyContinue > $null
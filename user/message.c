@@ -101,6 +101,22 @@ typedef enum
     WINDOW_TYPE_AVIWND,
 } WINDOW_TYPE;
 LPBYTE window_type_table;
+
+/* What a window was found to be by its wndproc and class name, so that the
+ * message thunks don't query user32 for it on every message. A record is
+ * only valid for the HWND it was made for, since 16-bit handles are reused. */
+#define WINDOW_INFO_WNDPROC     0x01    /* wndproc_type is valid */
+#define WINDOW_INFO_CLASS       0x02    /* class_type is valid */
+#define WINDOW_INFO_NOT_AVIWND  0x04    /* class is not AVIWnd32 */
+typedef struct
+{
+    HWND hwnd;
+    BYTE wndproc_type;  /* builtin control owning the wndproc, or WINDOW_TYPE_WINDOW */
+    BYTE class_type;    /* builtin control by base class name, or WINDOW_TYPE_WINDOW */
+    BYTE flags;
+} WINDOW_INFO;
+static WINDOW_INFO *window_info_table;
+static BYTE get_wndproc_type(HWND16 hWnd16, HWND hWnd);
 #include <pshpack1.h>
 typedef struct
 {
@@ -321,18 +337,8 @@ WNDPROC16 WINPROC_GetProc16( WNDPROC proc, BOOL unicode )
     int index = winproc_to_index( func );
     CONTEXT context;
     size_t size = 0;
-#include <pshpack1.h>
-    struct
-    {
-        WORD params[5];
-        union
-        {
-            CREATESTRUCT16 cs16;
-            DRAWITEMSTRUCT16 dis16;
-            COMPAREITEMSTRUCT16 cis16;
-        } u;
-    } args;
-#include <poppack.h>
+    PVOID old = getWOW32Reserved();
+    WORD *params;
 
     if (index >= MAX_WINPROCS32) func = winproc16_array[index - MAX_WINPROCS32];
 
@@ -368,20 +374,21 @@ WNDPROC16 WINPROC_GetProc16( WNDPROC proc, BOOL unicode )
           case WM_COMPAREITEM:
             size = sizeof(COMPAREITEMSTRUCT16); break;
         }
-        if (size)
-        {
-            memcpy( &args.u, MapSL(lParam), size );
-            lParam = PtrToUlong(getWOW32Reserved()) - size;
-        }
     }
-    PVOID old = getWOW32Reserved();
 
-    args.params[4] = hwnd;
-    args.params[3] = msg;
-    args.params[2] = wParam;
-    args.params[1] = HIWORD(lParam);
-    args.params[0] = LOWORD(lParam);
-    WOWCallback16Ex( 0, WCB16_REGS, sizeof(args.params) + size, &args, (DWORD *)&context );
+    /* Build the frame in place below ss:sp, WOWCallback16Ex won't copy it again */
+    params = (WORD *)((char *)MapSL( PtrToUlong(old) ) - size) - 5;
+    if (size)
+    {
+        memmove( params + 5, MapSL(lParam), size );
+        lParam = PtrToUlong(old) - size;
+    }
+    params[4] = hwnd;
+    params[3] = msg;
+    params[2] = wParam;
+    params[1] = HIWORD(lParam);
+    params[0] = LOWORD(lParam);
+    WOWCallback16Ex( 0, WCB16_REGS, 5 * sizeof(WORD) + size, params, (DWORD *)&context );
     //restore stack
     setWOW32Reserved(old);
     *result = MAKELONG( LOWORD(context.Eax), LOWORD(context.Edx) );
@@ -753,8 +760,7 @@ BOOL isListBox(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_LISTBOX)
         return TRUE;
-    WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
-    return is_listbox_wndproc(lpfnWndProc);
+    return get_wndproc_type(hWnd16, hWnd) == WINDOW_TYPE_LISTBOX;
 }
 
 BOOL is_edit_wndproc(WNDPROC lpfnWndProc)
@@ -771,8 +777,7 @@ BOOL isEdit(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_EDIT)
         return TRUE;
-    WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
-    return is_edit_wndproc(lpfnWndProc);
+    return get_wndproc_type(hWnd16, hWnd) == WINDOW_TYPE_EDIT;
 }
 
 BOOL is_scrollbar_wndproc(WNDPROC lpfnWndProc)
@@ -789,8 +794,7 @@ BOOL isScrollBar(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_SCROLLBAR)
         return TRUE;
-    WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
-    return is_scrollbar_wndproc(lpfnWndProc);
+    return get_wndproc_type(hWnd16, hWnd) == WINDOW_TYPE_SCROLLBAR;
 }
 
 BOOL is_combobox_wndproc(WNDPROC lpfnWndProc)
@@ -807,8 +811,7 @@ BOOL isComboBox(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_COMBOBOX)
         return TRUE;
-    WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
-    return is_combobox_wndproc(lpfnWndProc);
+    return get_wndproc_type(hWnd16, hWnd) == WINDOW_TYPE_COMBOBOX;
 }
 
 BOOL is_static_wndproc(WNDPROC lpfnWndProc)
@@ -825,8 +828,7 @@ BOOL isStatic(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_STATIC)
         return TRUE;
-    WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
-    return is_static_wndproc(lpfnWndProc);
+    return get_wndproc_type(hWnd16, hWnd) == WINDOW_TYPE_STATIC;
 }
 
 BOOL is_button_wndproc(WNDPROC lpfnWndProc)
@@ -843,8 +845,7 @@ BOOL isButton(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_BUTTON)
         return TRUE;
-    WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
-    return is_button_wndproc(lpfnWndProc);
+    return get_wndproc_type(hWnd16, hWnd) == WINDOW_TYPE_BUTTON;
 }
 
 BOOL is_mdiclient_wndproc(WNDPROC lpfnWndProc)
@@ -862,18 +863,65 @@ BOOL is_mdiclient_wndproc(WNDPROC lpfnWndProc)
     }
     return lpfnWndProc ? (lpfnWndProc == lpfnWndProc1 || lpfnWndProc == lpfnWndProc2) : FALSE;
 }
+static WINDOW_INFO *get_window_info(HWND16 hWnd16, HWND hWnd)
+{
+    WINDOW_INFO *info = &window_info_table[hWnd16];
+    if (info->hwnd != hWnd)
+    {
+        info->flags = 0;
+        info->hwnd = hWnd;
+    }
+    return info;
+}
+
+/* builtin control whose wndproc the window currently has */
+static BYTE get_wndproc_type(HWND16 hWnd16, HWND hWnd)
+{
+    WINDOW_INFO *info = get_window_info(hWnd16, hWnd);
+    if (!(info->flags & WINDOW_INFO_WNDPROC))
+    {
+        WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
+        BYTE type = WINDOW_TYPE_WINDOW;
+        if (is_listbox_wndproc(lpfnWndProc))
+            type = WINDOW_TYPE_LISTBOX;
+        else if (is_edit_wndproc(lpfnWndProc))
+            type = WINDOW_TYPE_EDIT;
+        else if (is_scrollbar_wndproc(lpfnWndProc))
+            type = WINDOW_TYPE_SCROLLBAR;
+        else if (is_combobox_wndproc(lpfnWndProc))
+            type = WINDOW_TYPE_COMBOBOX;
+        else if (is_static_wndproc(lpfnWndProc))
+            type = WINDOW_TYPE_STATIC;
+        else if (is_button_wndproc(lpfnWndProc))
+            type = WINDOW_TYPE_BUTTON;
+        else if (is_mdiclient_wndproc(lpfnWndProc))
+            type = WINDOW_TYPE_MDICLIENT;
+        info->wndproc_type = type;
+        info->flags |= WINDOW_INFO_WNDPROC;
+    }
+    return info->wndproc_type;
+}
+
+/* called when the wndproc of a window is replaced */
+void invalidate_window_wndproc_type(HWND16 hWnd16)
+{
+    window_info_table[hWnd16].flags &= ~WINDOW_INFO_WNDPROC;
+}
+
 BOOL is_mdiclient(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_MDICLIENT)
         return TRUE;
-    WNDPROC lpfnWndProc = (WNDPROC)GetWindowLongPtrA(hWnd, GWLP_WNDPROC);
-    return is_mdiclient_wndproc(lpfnWndProc);
+    return get_wndproc_type(hWnd16, hWnd) == WINDOW_TYPE_MDICLIENT;
 }
 
 BOOL is_aviwnd(HWND16 hWnd16, HWND hWnd)
 {
     if (window_type_table[hWnd16] == WINDOW_TYPE_AVIWND)
         return TRUE;
+    WINDOW_INFO *info = get_window_info(hWnd16, hWnd);
+    if (info->flags & WINDOW_INFO_NOT_AVIWND)
+        return FALSE;
     char name[10];
     if (GetClassNameA(hWnd, &name, 10))
     {
@@ -882,6 +930,7 @@ BOOL is_aviwnd(HWND16 hWnd16, HWND hWnd)
             window_type_table[hWnd16] = WINDOW_TYPE_AVIWND;
             return TRUE;
         }
+        info->flags |= WINDOW_INFO_NOT_AVIWND;
     }
     return FALSE;
 }
@@ -1479,8 +1528,7 @@ LRESULT WINPROC_CallProc16To32A( winproc_callback_t callback, HWND16 hwnd, UINT1
     LRESULT ret = 0;
     HWND hwnd32 = WIN_Handle32( hwnd );
 
-    const char *msg_str = message_to_str(msg);
-    TRACE("(%p, %04X, %s(%04X), %04X, %08X)\n", callback, hwnd, msg_str, msg, wParam, lParam);
+    TRACE("(%p, %04X, %s(%04X), %04X, %08X)\n", callback, hwnd, message_to_str(msg), msg, wParam, lParam);
     if (isListBox(hwnd, hwnd32) || (call_window_proc_callback == callback && is_listbox_wndproc(arg)))
 	{
         BOOL f;
@@ -2038,6 +2086,29 @@ static HICON16 get_default_icon(HINSTANCE16 inst)
 #include "../mmsystem/winemm16.h"
 
 void InitWndProc16(HWND hWnd, HWND16 hWnd16);
+
+/* Control class implied by a control message, or WINDOW_TYPE_WINDOW.
+ * The control message ranges don't overlap and all lie between EM_GETSEL
+ * and LB_MSGMAX, so most messages only need the first test. */
+static inline BYTE get_control_message_type(UINT msg)
+{
+    if (msg < EM_GETSEL || msg > LB_MSGMAX)
+        return WINDOW_TYPE_WINDOW;
+    if (msg <= EM_ENABLEFEATURE)
+        return WINDOW_TYPE_EDIT;
+    if (SBM_SETPOS <= msg && msg <= SBM_GETSCROLLBARINFO)
+        return WINDOW_TYPE_SCROLLBAR;
+    if (BM_GETCHECK <= msg && msg <= BM_SETDONTCLICK)
+        return WINDOW_TYPE_BUTTON;
+    if (CB_GETEDITSEL <= msg && msg <= CB_MSGMAX)
+        return WINDOW_TYPE_COMBOBOX;
+    if (STM_SETICON <= msg && msg <= STM_MSGMAX)
+        return WINDOW_TYPE_STATIC;
+    if (LB_ADDSTRING <= msg)
+        return WINDOW_TYPE_LISTBOX;
+    return WINDOW_TYPE_WINDOW;
+}
+
 /**********************************************************************
  *	     WINPROC_CallProc32ATo16
  *
@@ -2049,31 +2120,11 @@ LRESULT WINPROC_CallProc32ATo16( winproc_callback16_t callback, HWND hwnd, UINT
     LRESULT ret = 0;
 
     HWND16 hwnd16 = HWND_16(hwnd);
-    const char *msg_str = message_to_str(msg);
-    TRACE("(%p, %p, %s(%04X), %08X, %08X)\n", callback, hwnd, msg_str, msg, wParam, lParam);
-    if (BM_GETCHECK <= msg && msg <= BM_SETDONTCLICK)
-    {
-        window_type_table[hwnd16] = (BYTE)WINDOW_TYPE_BUTTON;
-    }
-    if (LB_ADDSTRING <= msg && msg <= LB_MSGMAX)
+    BYTE control_type;
+    TRACE("(%p, %p, %s(%04X), %08X, %08X)\n", callback, hwnd, message_to_str(msg), msg, wParam, lParam);
+    if ((control_type = get_control_message_type(msg)) != WINDOW_TYPE_WINDOW)
     {
-        window_type_table[hwnd16] = (BYTE)WINDOW_TYPE_LISTBOX;
-    }
-    if (STM_SETICON <= msg && msg <= STM_MSGMAX)
-    {
-        window_type_table[hwnd16] = (BYTE)WINDOW_TYPE_STATIC;
-    }
-    if (SBM_SETPOS <= msg && msg <= SBM_GETSCROLLBARINFO)
-    {
-        window_type_table[hwnd16] = (BYTE)WINDOW_TYPE_SCROLLBAR;
-    }
-    if (EM_GETSEL <= msg && msg <= EM_ENABLEFEATURE)
-    {
-        window_type_table[hwnd16] = (BYTE)WINDOW_TYPE_EDIT;
-    }
-    if (CB_GETEDITSEL <= msg && msg <= CB_MSGMAX)
-    {
-        window_type_table[hwnd16] = (BYTE)WINDOW_TYPE_COMBOBOX;
+        window_type_table[hwnd16] = control_type;
     }
     if (is_aviwnd(hwnd16, hwnd) && (GetWindowThreadProcessId(hwnd, NULL) == GetCurrentThreadId()))
     {
@@ -4703,36 +4754,62 @@ void set_window_app_id(HWND hwnd)
     }
     set_app_id(hwnd, buffer);
 }
+static BYTE get_class_type(HWND16 hwnd, HWND hwnd32)
+{
+    WINDOW_INFO *info = get_window_info(hwnd, hwnd32);
+    if (!(info->flags & WINDOW_INFO_CLASS))
+    {
+        char name[100];
+        BYTE type = WINDOW_TYPE_WINDOW;
+        RealGetWindowClassA(hwnd32, name, 100);
+        if (!stricmp(name, "LISTBOX") || !stricmp(name, "COMBOLBOX"))
+            type = WINDOW_TYPE_LISTBOX;
+        else if (!stricmp(name, "COMBOBOX"))
+            type = WINDOW_TYPE_COMBOBOX;
+        else if (!stricmp(name, "BUTTON"))
+            type = WINDOW_TYPE_BUTTON;
+        else if (!stricmp(name, "EDIT"))
+            type = WINDOW_TYPE_EDIT;
+        else if (!stricmp(name, "SCROLLBAR"))
+            type = WINDOW_TYPE_SCROLLBAR;
+        else if (!stricmp(name, "STATIC"))
+            type = WINDOW_TYPE_STATIC;
+        else if (!stricmp(name, "MDICLIENT"))
+            type = WINDOW_TYPE_MDICLIENT;
+        info->class_type = type;
+        info->flags |= WINDOW_INFO_CLASS;
+    }
+    return info->class_type;
+}
 void detect_window_type(HWND16 hwnd, HWND hwnd32)
 {
-    char name[100];
-    RealGetWindowClassA(hwnd32, name, 100);
+    BYTE class_type = get_class_type(hwnd, hwnd32);
     /* detect window type */
-    if (isListBox(hwnd, hwnd32) || !stricmp(name, "LISTBOX") || !stricmp(name, "COMBOLBOX"))
+    if (isListBox(hwnd, hwnd32) || class_type == WINDOW_TYPE_LISTBOX)
     {
         window_type_table[hwnd] = (BYTE)WINDOW_TYPE_LISTBOX;
     }
-    if (isComboBox(hwnd, hwnd32) || !stricmp(name, "COMBOBOX"))
+    if (isComboBox(hwnd, hwnd32) || class_type == WINDOW_TYPE_COMBOBOX)
     {
         window_type_table[hwnd] = (BYTE)WINDOW_TYPE_COMBOBOX;
     }
-    if (isButton(hwnd, hwnd32) || !stricmp(name, "BUTTON"))
+    if (isButton(hwnd, hwnd32) || class_type == WINDOW_TYPE_BUTTON)
     {
         window_type_table[hwnd] = (BYTE)WINDOW_TYPE_BUTTON;
     }
-    if (isEdit(hwnd, hwnd32) || !stricmp(name, "EDIT"))
+    if (isEdit(hwnd, hwnd32) || class_type == WINDOW_TYPE_EDIT)
     {
         window_type_table[hwnd] = (BYTE)WINDOW_TYPE_EDIT;
     }
-    if (isScrollBar(hwnd, hwnd32) || !stricmp(name, "SCROLLBAR"))
+    if (isScrollBar(hwnd, hwnd32) || class_type == WINDOW_TYPE_SCROLLBAR)
     {
         window_type_table[hwnd] = (BYTE)WINDOW_TYPE_SCROLLBAR;
     }
-    if (isStatic(hwnd, hwnd32) || !stricmp(name, "STATIC"))
+    if (isStatic(hwnd, hwnd32) || class_type == WINDOW_TYPE_STATIC)
     {
         window_type_table[hwnd] = (BYTE)WINDOW_TYPE_STATIC;
     }
-    if (is_mdiclient(hwnd, hwnd32) || !stricmp(name, "MDICLIENT"))
+    if (is_mdiclient(hwnd, hwnd32) || class_type == WINDOW_TYPE_MDICLIENT)
     {
         window_type_table[hwnd] = (BYTE)WINDOW_TYPE_MDICLIENT;
     }
@@ -4940,6 +5017,7 @@ BOOL WINAPI DllMain(
     {
         load_user32_functions();
         window_type_table = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 65536);
+        window_info_table = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 65536 * sizeof(WINDOW_INFO));
         aero_diasble = krnl386_get_config_int("otvdm", "DisableAero", TRUE);
         if (!IsThemeActive())
         {
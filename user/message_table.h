@@ -1010,7 +1010,7 @@ static const char *msg_table[] = {
 
 static const char *message_to_str(UINT msg)
 {
-    if (sizeof(msg_table) / sizeof(char*) < msg)
+    if (sizeof(msg_table) / sizeof(char*) <= msg)
         return NULL;
     return msg_table[msg];
 }
\ No newline at end of file
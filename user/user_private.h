@@ -95,6 +95,7 @@ extern LRESULT WINPROC_CallProc32ATo16( winproc_callback16_t callback, HWND hwnd
                                         WPARAM wParam, LPARAM lParam, LRESULT *result, void *arg ) DECLSPEC_HIDDEN;
 
 extern void call_WH_CALLWNDPROC_hook( HWND16 hwnd, UINT16 *msg, WPARAM16 *wp, LPARAM *lp ) DECLSPEC_HIDDEN;
+extern void invalidate_window_wndproc_type( HWND16 hwnd ) DECLSPEC_HIDDEN;
 
 #define GET_BYTE(ptr)  (*(const BYTE *)(ptr))
 #define GET_WORD(ptr)  (*(const WORD *)(ptr))
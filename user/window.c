@@ -122,6 +122,7 @@ BOOL CALLBACK remove_wndproc(HWND hwnd, LPARAM lparam)
         TRACE("HWND %x WNDPROC removed\n", hwnd);
         EnumChildWindows(hwnd, remove_wndproc, lparam);
         SetWindowLongPtrA(hwnd, GWLP_WNDPROC, DefWindowProcA);
+        invalidate_window_wndproc_type(HWND_16(hwnd));
     }
     return TRUE;
 }
@@ -135,6 +136,7 @@ BOOL CALLBACK enum_thread_window(HWND hwnd, LPARAM lparam)
         {
             TRACE("HWND %x WNDPROC removed\n", hwnd);
             SetWindowLongPtrA(hwnd, GWLP_WNDPROC, DefWindowProcA);
+            invalidate_window_wndproc_type(HWND_16(hwnd));
         }
         TRACE("HWND %x destroyed\n", hwnd);
         DestroyWindow(hwnd);
@@ -1731,6 +1733,7 @@ LONG WINAPI SetWindowLong16( HWND16 hwnd16, INT16 offset, LONG newval )
         else if (oldproc != WindowProc16)
         {
             SetWindowLongA(hwnd, offset, WindowProc16);
+            invalidate_window_wndproc_type(hwnd16);
         }
 		return old;
     }
@@ -0,0 +1,936 @@
+/*
+	Standalone benchmark and conformance harness for the i386 core
+
+	The core is pulled in by textual inclusion the same way msdos.cpp does
+	it, with a flat memory model and stub port callbacks in place of the
+	Win32 host. Guest code runs in 16-bit protected mode at CPL 3 with one
+	table serving as GDT and LDT, as under vm86main.
+
+	usage: vm86bench [-v] [-hostfpu] [-n count] bench [name...]
+	       vm86bench trace [-write] file
+	       vm86bench x87 [count]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <assert.h>
+#include <chrono>
+
+typedef unsigned char UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int UINT32;
+typedef unsigned long long UINT64;
+typedef signed char INT8;
+typedef signed short INT16;
+typedef signed int INT32;
+typedef signed long long INT64;
+typedef unsigned int UINT;
+typedef UINT16 WORD;
+typedef UINT32 DWORD;
+typedef int BOOL;
+
+#define WINAPI
+#define __stdcall
+#define __declspec(x)
+
+int ignore_illegal_insn;
+
+#define fatalerror(...) { \
+	fprintf(stderr, __VA_ARGS__); \
+	exit(1); \
+}
+#define error(...) fprintf(stderr, "error: " __VA_ARGS__)
+
+/* there is no MS-DOS iret area, the iret hook in the core never fires */
+#define IRET_TOP	0xffffff00
+#define IRET_SIZE	0x100
+void msdos_syscall(unsigned num);
+int pic_ack();
+
+/* ----------------------------------------------------------------------------
+	MAME i386
+---------------------------------------------------------------------------- */
+
+#define SUPPORT_DISASSEMBLER
+#define CPU_MODEL i486
+#define SUPPORT_FPU
+#define HAS_I386
+
+#define LSB_FIRST
+#define INLINE inline
+#define U64(v) UINT64(v)
+
+/* the core logs every guest fault, which the kernels take on purpose */
+static bool verbose = false;
+
+void logerror(const char *format, ...)
+{
+	va_list arg;
+
+	if (!verbose)
+		return;
+	va_start(arg, format);
+	vfprintf(stderr, format, arg);
+	va_end(arg);
+}
+#define popmessage(...)
+
+/* src/emu/devcpu.h */
+#define CPU_INIT_NAME(name)			cpu_init_##name
+#define CPU_INIT(name)				void CPU_INIT_NAME(name)()
+#define CPU_INIT_CALL(name)			CPU_INIT_NAME(name)()
+
+#define CPU_RESET_NAME(name)			cpu_reset_##name
+#define CPU_RESET(name)				void CPU_RESET_NAME(name)()
+#define CPU_RESET_CALL(name)			CPU_RESET_NAME(name)()
+
+#define CPU_EXECUTE_NAME(name)			cpu_execute_##name
+#define CPU_EXECUTE(name)			void CPU_EXECUTE_NAME(name)()
+#define CPU_EXECUTE_CALL(name)			CPU_EXECUTE_NAME(name)()
+
+#define CPU_TRANSLATE_NAME(name)		cpu_translate_##name
+#define CPU_TRANSLATE(name)			int CPU_TRANSLATE_NAME(name)(address_spacenum space, int intention, offs_t *address)
+#define CPU_TRANSLATE_CALL(name)		CPU_TRANSLATE_NAME(name)(space, intention, address)
+
+#define CPU_DISASSEMBLE_NAME(name)		cpu_disassemble_##name
+#define CPU_DISASSEMBLE(name)			int CPU_DISASSEMBLE_NAME(name)(char *buffer, offs_t eip, const UINT8 *oprom)
+#define CPU_DISASSEMBLE_CALL(name)		CPU_DISASSEMBLE_NAME(name)(buffer, eip, oprom)
+
+/* src/emu/didisasm.h */
+const UINT32 DASMFLAG_SUPPORTED     = 0x80000000;
+const UINT32 DASMFLAG_STEP_OUT      = 0x40000000;
+const UINT32 DASMFLAG_STEP_OVER     = 0x20000000;
+const UINT32 DASMFLAG_OVERINSTMASK  = 0x18000000;
+const UINT32 DASMFLAG_OVERINSTSHIFT = 27;
+const UINT32 DASMFLAG_LENGTHMASK    = 0x0000ffff;
+
+/* src/emu/diexec.h */
+enum line_state
+{
+	CLEAR_LINE = 0,
+	ASSERT_LINE,
+	HOLD_LINE,
+	PULSE_LINE
+};
+
+enum
+{
+	INPUT_LINE_IRQ = 0,
+	INPUT_LINE_NMI
+};
+
+/* src/emu/dimemory.h */
+const int TRANSLATE_TYPE_MASK       = 0x03;
+const int TRANSLATE_USER_MASK       = 0x04;
+const int TRANSLATE_DEBUG_MASK      = 0x08;
+
+const int TRANSLATE_READ            = 0;
+const int TRANSLATE_WRITE           = 1;
+const int TRANSLATE_FETCH           = 2;
+const int TRANSLATE_READ_USER       = (TRANSLATE_READ | TRANSLATE_USER_MASK);
+const int TRANSLATE_WRITE_USER      = (TRANSLATE_WRITE | TRANSLATE_USER_MASK);
+const int TRANSLATE_FETCH_USER      = (TRANSLATE_FETCH | TRANSLATE_USER_MASK);
+const int TRANSLATE_READ_DEBUG      = (TRANSLATE_READ | TRANSLATE_DEBUG_MASK);
+const int TRANSLATE_WRITE_DEBUG     = (TRANSLATE_WRITE | TRANSLATE_DEBUG_MASK);
+const int TRANSLATE_FETCH_DEBUG     = (TRANSLATE_FETCH | TRANSLATE_DEBUG_MASK);
+
+/* src/emu/emucore.h */
+enum endianness_t
+{
+	ENDIANNESS_LITTLE,
+	ENDIANNESS_BIG
+};
+const endianness_t ENDIANNESS_NATIVE = ENDIANNESS_LITTLE;
+#define ENDIAN_VALUE_LE_BE(endian,leval,beval)	(((endian) == ENDIANNESS_LITTLE) ? (leval) : (beval))
+#define NATIVE_ENDIAN_VALUE_LE_BE(leval,beval)	ENDIAN_VALUE_LE_BE(ENDIANNESS_NATIVE, leval, beval)
+
+/* src/emu/memory.h */
+enum address_spacenum
+{
+	AS_0,
+	AS_1,
+	AS_2,
+	AS_3,
+	ADDRESS_SPACES,
+
+	AS_PROGRAM = AS_0,
+	AS_DATA = AS_1,
+	AS_IO = AS_2
+};
+
+typedef UINT32	offs_t;
+
+/* flat guest memory, linear addresses are offsets into it */
+#define MEM_SIZE	0x100000
+UINT8 *mem;
+
+void *read_ptr(offs_t byteaddress)
+{
+	return nullptr;
+}
+
+UINT8 read_byte(offs_t byteaddress)
+{
+	return mem[byteaddress];
+}
+
+UINT16 read_word(offs_t byteaddress)
+{
+	return *(UINT16 *)(mem + byteaddress);
+}
+
+UINT32 read_dword(offs_t byteaddress)
+{
+	return *(UINT32 *)(mem + byteaddress);
+}
+
+void write_byte(offs_t byteaddress, UINT8 data)
+{
+	mem[byteaddress] = data;
+}
+
+void write_word(offs_t byteaddress, UINT16 data)
+{
+	*(UINT16 *)(mem + byteaddress) = data;
+}
+
+void write_dword(offs_t byteaddress, UINT32 data)
+{
+	*(UINT32 *)(mem + byteaddress) = data;
+}
+
+#define read_decrypted_byte read_byte
+#define read_decrypted_word read_word
+#define read_decrypted_dword read_dword
+
+#define read_raw_byte read_byte
+#define write_raw_byte write_byte
+
+#define read_word_unaligned read_word
+#define write_word_unaligned write_word
+
+#define read_io_word_unaligned read_io_word
+#define write_io_word_unaligned write_io_word
+
+UINT8 read_io_byte(offs_t byteaddress);
+UINT16 read_io_word(offs_t byteaddress);
+UINT32 read_io_dword(offs_t byteaddress);
+
+void write_io_byte(offs_t byteaddress, UINT8 data);
+void write_io_word(offs_t byteaddress, UINT16 data);
+void write_io_dword(offs_t byteaddress, UINT32 data);
+
+/* src/osd/osdcomm.h */
+#define ARRAY_LENGTH(x)     (sizeof(x) / sizeof(x[0]))
+
+static CPU_TRANSLATE(i386);
+#include "../mame/lib/softfloat/softfloat.c"
+#include "../mame/lib/softfloat/fsincos.c"
+#include "../mame/lib/softfloat/f2xm1.c"
+#include "../mame/lib/softfloat/fpatan.c"
+#include "../mame/lib/softfloat/fyl2x.c"
+#include "../mame/emu/cpu/i386/i386.c"
+#include "../mame/emu/cpu/vtlb.c"
+#include "../mame/emu/cpu/i386/i386dasm.c"
+
+#define SREG(x)				m_sreg[x].selector
+
+/* ----------------------------------------------------------------------------
+	host stubs
+---------------------------------------------------------------------------- */
+
+void msdos_syscall(unsigned int a)
+{
+}
+
+int pic_ack()
+{
+	return 0;
+}
+
+/* ports read back what was last written to them, xored so reads are visible */
+static UINT8 ports[0x10000];
+static UINT32 port_reads, port_writes;
+
+UINT8 read_io_byte(offs_t addr)
+{
+	port_reads++;
+	return ports[addr & 0xffff] ^ 0x5a;
+}
+
+UINT16 read_io_word(offs_t addr)
+{
+	return(read_io_byte(addr) | (read_io_byte(addr + 1) << 8));
+}
+
+UINT32 read_io_dword(offs_t addr)
+{
+	return(read_io_byte(addr) | (read_io_byte(addr + 1) << 8) | (read_io_byte(addr + 2) << 16) | (read_io_byte(addr + 3) << 24));
+}
+
+void write_io_byte(offs_t addr, UINT8 val)
+{
+	port_writes++;
+	ports[addr & 0xffff] = val;
+}
+
+void write_io_word(offs_t addr, UINT16 val)
+{
+	write_io_byte(addr + 0, (val >> 0) & 0xff);
+	write_io_byte(addr + 1, (val >> 8) & 0xff);
+}
+
+void write_io_dword(offs_t addr, UINT32 val)
+{
+	write_io_byte(addr + 0, (val >>  0) & 0xff);
+	write_io_byte(addr + 1, (val >>  8) & 0xff);
+	write_io_byte(addr + 2, (val >> 16) & 0xff);
+	write_io_byte(addr + 3, (val >> 24) & 0xff);
+}
+
+/* ----------------------------------------------------------------------------
+	guest machine
+---------------------------------------------------------------------------- */
+
+#define IDT_BASE	0x00000
+#define STUB_BASE	0x01000
+#define LDT_BASE	0x10000
+#define CODE_BASE	0x20000
+#define CODE2_BASE	0x30000
+#define DATA_BASE	0x40000
+#define DATA2_BASE	0x50000
+#define STACK_BASE	0x60000
+
+/* LDT selectors with RPL 3, the kernels below have them hard coded */
+#define SEL_CODE	0x0f
+#define SEL_CODE2	0x17
+#define SEL_DATA	0x1f
+#define SEL_DATA2	0x27
+#define SEL_STACK	0x2f
+#define SEL_STUB	0x37
+#define SEL_NOTP	0x3f
+#define SEL_SMALL	0x47
+
+/* the fault handler in CODE2 skips the two byte instruction that faulted */
+#define HANDLER_IP	0x02
+
+static const UINT8 code2[] =
+{
+	0x40,					/* 00: inc ax */
+	0xcb,					/*     retf */
+	0x83, 0xc4, 0x02,			/* 02: add sp,2 */
+	0x55,					/*     push bp */
+	0x89, 0xe5,				/*     mov bp,sp */
+	0x83, 0x46, 0x02, 0x02,			/*     add word [bp+2],2 */
+	0x5d,					/*     pop bp */
+	0xcf,					/*     iret */
+};
+
+/* x87 operands at DATA:0, control word at DATA:30 (53-bit, nearest, all masked) */
+static const double x87_data[] = { 1.25, 3.0e-3, 0.875, 1.0000001, 2.5e-7 };
+static const UINT16 x87_cw = 0x027f;
+
+static void set_descriptor(int sel, UINT32 base, UINT32 limit, UINT8 ar)
+{
+	UINT8 *d = mem + LDT_BASE + (sel & ~7);
+
+	d[0] = limit & 0xff;
+	d[1] = (limit >> 8) & 0xff;
+	d[2] = base & 0xff;
+	d[3] = (base >> 8) & 0xff;
+	d[4] = (base >> 16) & 0xff;
+	d[5] = ar;
+	d[6] = (limit >> 16) & 0x0f;
+	d[7] = (base >> 24) & 0xff;
+}
+
+static void machine_init()
+{
+	mem = (UINT8 *)calloc(1, MEM_SIZE);
+	if (!mem)
+		fatalerror("out of memory\n");
+	CPU_INIT_CALL(CPU_MODEL);
+}
+
+/* Resets the CPU and memory and loads code at CODE:0000, ready to run */
+static void machine_reset(const UINT8 *code, size_t size)
+{
+	memset(mem, 0, MEM_SIZE);
+	memset(ports, 0, sizeof(ports));
+	port_reads = port_writes = 0;
+
+	CPU_RESET_CALL(CPU_MODEL);
+	m_cr[0] |= 0x21;	/* protected mode, native x87 errors */
+	m_a20_mask = ~0;
+	m_idtr.base = IDT_BASE;
+	m_idtr.limit = 0x7ff;
+	m_ldtr.base = m_gdtr.base = LDT_BASE;
+	m_ldtr.limit = m_gdtr.limit = 0xffff;
+	m_CPL = 3;
+
+	set_descriptor(SEL_CODE, CODE_BASE, 0xffff, 0xfa);
+	set_descriptor(SEL_CODE2, CODE2_BASE, 0xffff, 0xfa);
+	set_descriptor(SEL_DATA, DATA_BASE, 0xffff, 0xf2);
+	set_descriptor(SEL_DATA2, DATA2_BASE, 0xffff, 0xf2);
+	set_descriptor(SEL_STACK, STACK_BASE, 0xffff, 0xf2);
+	set_descriptor(SEL_STUB, STUB_BASE, 0xff, 0xfa);
+	set_descriptor(SEL_NOTP, DATA2_BASE, 0xffff, 0x72);
+	set_descriptor(SEL_SMALL, DATA2_BASE, 0xff, 0xf2);
+
+	/* every vector goes to an iret, faults to the handler in CODE2 */
+	memset(mem + STUB_BASE, 0xcf, 256);
+	for (int i = 0; i < 256; i++)
+	{
+		UINT8 *gate = mem + IDT_BASE + i * 8;
+		int fault = i == FAULT_NP || i == FAULT_GP || i == FAULT_SS;
+
+		*(UINT16 *)(gate + 0) = fault ? HANDLER_IP : i;
+		*(UINT16 *)(gate + 2) = fault ? SEL_CODE2 : SEL_STUB;
+		gate[5] = 0x86 | 0x60;
+	}
+
+	memcpy(mem + CODE_BASE, code, size);
+	memcpy(mem + CODE2_BASE, code2, sizeof(code2));
+	memcpy(mem + DATA_BASE, x87_data, sizeof(x87_data));
+	memcpy(mem + DATA_BASE + 0x30, &x87_cw, sizeof(x87_cw));
+
+	set_flags(0x3202);	/* IOPL 3, IF */
+	SREG(CS) = SEL_CODE;
+	SREG(SS) = SEL_STACK;
+	SREG(DS) = SEL_DATA;
+	SREG(ES) = SEL_DATA2;
+	SREG(FS) = 0;
+	SREG(GS) = 0;
+	for (int i = 0; i < 6; i++)
+		i386_load_segment_descriptor(i);
+	m_eip = 0;
+	REG32(ESP) = 0xfffc;
+	CHANGE_PC(m_eip);
+
+	/* kernels end with a far return to STUB:0, where the run stops */
+	REG16(SP) -= 4;
+	*(UINT16 *)(mem + STACK_BASE + REG16(SP)) = 0;
+	*(UINT16 *)(mem + STACK_BASE + REG16(SP) + 2) = SEL_STUB;
+}
+
+INLINE int machine_stopped()
+{
+	return SREG(CS) == SEL_STUB && !m_eip;
+}
+
+/* ----------------------------------------------------------------------------
+	instruction mix kernels, BX holds the iteration count
+---------------------------------------------------------------------------- */
+
+static const UINT8 k_alu[] =
+{
+	0x89, 0xf0,				/* 00: mov ax,si */
+	0x01, 0xf8,				/*     add ax,di */
+	0x31, 0xc2,				/*     xor dx,ax */
+	0xd1, 0xe0,				/*     shl ax,1 */
+	0x11, 0xd6,				/*     adc si,dx */
+	0x83, 0xef, 0x03,			/*     sub di,3 */
+	0x81, 0xe2, 0xff, 0x7f,			/*     and dx,7fff */
+	0x83, 0xce, 0x01,			/*     or si,1 */
+	0x45,					/*     inc bp */
+	0x39, 0xd0,				/*     cmp ax,dx */
+	0x4b,					/*     dec bx */
+	0x75, 0xe6,				/*     jnz 00 */
+	0xcb,					/*     retf */
+};
+
+static const UINT8 k_string[] =
+{
+	0xfc,					/*     cld */
+	0x31, 0xf6,				/* 01: xor si,si */
+	0xbf, 0x00, 0x01,			/*     mov di,100 */
+	0xb9, 0x80, 0x00,			/*     mov cx,80 */
+	0xf3, 0xa5,				/*     rep movsw */
+	0x89, 0xd8,				/*     mov ax,bx */
+	0xb9, 0x80, 0x00,			/*     mov cx,80 */
+	0xf3, 0xab,				/*     rep stosw */
+	0x31, 0xf6,				/*     xor si,si */
+	0xb9, 0x40, 0x00,			/*     mov cx,40 */
+	0xad,					/* 17: lodsw */
+	0x01, 0xc2,				/*     add dx,ax */
+	0xe2, 0xfb,				/*     loop 17 */
+	0x4b,					/*     dec bx */
+	0x75, 0xe2,				/*     jnz 01 */
+	0xcb,					/*     retf */
+};
+
+static const UINT8 k_x87[] =
+{
+	0xdb, 0xe3,				/*     fninit */
+	0xd9, 0x2e, 0x30, 0x00,			/*     fldcw [30] */
+	0xdd, 0x06, 0x00, 0x00,			/* 06: fld qword [00] */
+	0xdc, 0x06, 0x08, 0x00,			/*     fadd qword [08] */
+	0xdc, 0x0e, 0x10, 0x00,			/*     fmul qword [10] */
+	0xdc, 0x36, 0x18, 0x00,			/*     fdiv qword [18] */
+	0xdc, 0x26, 0x20, 0x00,			/*     fsub qword [20] */
+	0xdd, 0x1e, 0x28, 0x00,			/*     fstp qword [28] */
+	0x4b,					/*     dec bx */
+	0x75, 0xe5,				/*     jnz 06 */
+	0xcb,					/*     retf */
+};
+
+static const UINT8 k_far[] =
+{
+	0x9a, 0x00, 0x00, SEL_CODE2, 0x00,	/* 00: call CODE2:0000 */
+	0x4b,					/*     dec bx */
+	0x75, 0xf8,				/*     jnz 00 */
+	0xcb,					/*     retf */
+};
+
+static const UINT8 k_segment[] =
+{
+	0x8c, 0xda,				/*     mov dx,ds */
+	0xb8, SEL_DATA2, 0x00,			/* 02: mov ax,DATA2 */
+	0x8e, 0xc0,				/*     mov es,ax */
+	0x8e, 0xe2,				/*     mov fs,dx */
+	0x06,					/*     push es */
+	0x0f, 0xa9,				/*     pop gs */
+	0x1e,					/*     push ds */
+	0x07,					/*     pop es */
+	0x8e, 0xd8,				/*     mov ds,ax */
+	0x8e, 0xda,				/*     mov ds,dx */
+	0x4b,					/*     dec bx */
+	0x75, 0xed,				/*     jnz 02 */
+	0xcb,					/*     retf */
+};
+
+/* Reads through a 256 byte segment, inside the limit and past it. Memory
+   faults are the ones raised with FAULT_THROW, and the handler in CODE2
+   skips the faulting lodsw, so both loops run the same code. */
+static const UINT8 k_nofault[] =
+{
+	0xb8, SEL_SMALL, 0x00,			/*     mov ax,SMALL */
+	0x8e, 0xc0,				/*     mov es,ax */
+	0xbe, 0x10, 0x00,			/* 05: mov si,0010 */
+	0x26, 0xad,				/*     es lodsw */
+	0x4b,					/*     dec bx */
+	0x75, 0xf8,				/*     jnz 05 */
+	0xcb,					/*     retf */
+};
+
+static const UINT8 k_fault[] =
+{
+	0xb8, SEL_SMALL, 0x00,			/*     mov ax,SMALL */
+	0x8e, 0xc0,				/*     mov es,ax */
+	0xbe, 0x00, 0x02,			/* 05: mov si,0200 */
+	0x26, 0xad,				/*     es lodsw */
+	0x4b,					/*     dec bx */
+	0x75, 0xf8,				/*     jnz 05 */
+	0xcb,					/*     retf */
+};
+
+/* a bit of everything for the golden trace, including a #NP fault raised
+   directly and a #GP raised with FAULT_THROW */
+static const UINT8 k_trace[] =
+{
+	0xb8, 0x34, 0x12,			/*     mov ax,1234 */
+	0x05, 0x78, 0x56,			/*     add ax,5678 */
+	0x19, 0xd2,				/*     sbb dx,dx */
+	0xf7, 0xe8,				/*     imul ax */
+	0xba, 0x40, 0x00,			/*     mov dx,40 */
+	0xee,					/*     out dx,al */
+	0xec,					/*     in al,dx */
+	0xa3, 0x40, 0x00,			/*     mov [40],ax */
+	0xb8, SEL_NOTP, 0x00,			/*     mov ax,NOTP */
+	0x8e, 0xc0,				/*     mov es,ax */
+	0xb8, SEL_SMALL, 0x00,			/*     mov ax,SMALL */
+	0x8e, 0xc0,				/*     mov es,ax */
+	0xbe, 0x00, 0x02,			/*     mov si,0200 */
+	0x26, 0xad,				/*     es lodsw */
+	0x1e,					/*     push ds */
+	0x07,					/*     pop es */
+	0xb9, 0x03, 0x00,			/*     mov cx,3 */
+	0x31, 0xff,				/*     xor di,di */
+	0xf3, 0xab,				/*     rep stosw */
+	0xdb, 0xe3,				/*     fninit */
+	0xd9, 0x2e, 0x30, 0x00,			/*     fldcw [30] */
+	0xdd, 0x06, 0x00, 0x00,			/*     fld qword [00] */
+	0xdc, 0x0e, 0x08, 0x00,			/*     fmul qword [08] */
+	0xdd, 0x1e, 0x28, 0x00,			/*     fstp qword [28] */
+	0x9a, 0x00, 0x00, SEL_CODE2, 0x00,	/*     call CODE2:0000 */
+	0x4b,					/*     dec bx */
+	0x75, 0xbc,				/*     jnz 00 */
+	0xcb,					/*     retf */
+};
+
+struct kernel
+{
+	const char *name;
+	const UINT8 *code;
+	size_t size;
+	UINT32 iterations;	/* per -n unit */
+	UINT32 faults;		/* per iteration */
+};
+
+static const struct kernel kernels[] =
+{
+	{ "alu",     k_alu,     sizeof(k_alu),     1000, 0 },
+	{ "string",  k_string,  sizeof(k_string),  100,  0 },
+	{ "x87",     k_x87,     sizeof(k_x87),     1000, 0 },
+	{ "far",     k_far,     sizeof(k_far),     1000, 0 },
+	{ "segment", k_segment, sizeof(k_segment), 1000, 0 },
+	{ "nofault", k_nofault, sizeof(k_nofault), 1000, 0 },
+	{ "fault",   k_fault,   sizeof(k_fault),   1000, 1 },
+};
+
+/* Runs until the kernel returns, returns the number of instructions executed */
+static UINT64 run(int max_insns)
+{
+	UINT64 count = 0;
+
+	while (!machine_stopped())
+		count += i386_execute_block(max_insns);
+	return count;
+}
+
+static int bench(int argc, char **argv, UINT32 scale)
+{
+	for (int i = 0; i < ARRAY_LENGTH(kernels); i++)
+	{
+		const struct kernel *k = &kernels[i];
+		int selected = !argc;
+
+		for (int j = 0; j < argc; j++)
+			if (!strcmp(argv[j], k->name))
+				selected = 1;
+		if (!selected)
+			continue;
+
+		/* BX only counts to 65535, so long runs are split into several */
+		UINT64 total = 0;
+		UINT32 left = k->iterations * scale;
+		auto start = std::chrono::steady_clock::now();
+		while (left)
+		{
+			UINT32 n = left > 0xffff ? 0xffff : left;
+
+			machine_reset(k->code, k->size);
+			REG16(BX) = n;
+			total += run(I386_BBC_MAX_RUN);
+			left -= n;
+		}
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%-8s %8.2f MIPS  (%llu instructions in %.3f s)", k->name, total / secs / 1e6, total, secs);
+		if (k->faults)
+			printf("  %.2f M faults/s", (double)k->iterations * scale * k->faults / secs / 1e6);
+		printf("\n");
+	}
+	return 0;
+}
+
+/* ----------------------------------------------------------------------------
+	golden trace
+---------------------------------------------------------------------------- */
+
+static void trace_state(char *buf, size_t size)
+{
+	snprintf(buf, size, "%04x:%04x ax=%04x cx=%04x dx=%04x bx=%04x sp=%04x bp=%04x si=%04x di=%04x ds=%04x es=%04x fl=%04x",
+		SREG(CS), m_eip, REG16(AX), REG16(CX), REG16(DX), REG16(BX), REG16(SP), REG16(BP), REG16(SI), REG16(DI),
+		SREG(DS), SREG(ES), get_flags() & 0xffff);
+}
+
+/* FNV-1a over the data, extra data and stack segments */
+static UINT32 memory_hash()
+{
+	UINT32 hash = 2166136261u;
+
+	for (UINT32 addr = DATA_BASE; addr < STACK_BASE + 0x10000; addr++)
+		hash = (hash ^ mem[addr]) * 16777619u;
+	return hash;
+}
+
+#define TRACE_MAX_STEPS	4096
+#define TRACE_LINE	160
+
+/* Single steps the trace kernel and records the state after every step by instruction count */
+static UINT64 trace_steps(UINT32 iterations, char (*steps)[TRACE_LINE])
+{
+	UINT64 count = 0;
+
+	machine_reset(k_trace, sizeof(k_trace));
+	REG16(BX) = iterations;
+	while (!machine_stopped())
+	{
+		if (count >= TRACE_MAX_STEPS - 1)
+			fatalerror("trace kernel did not return\n");
+		count += i386_execute_block(1);
+		trace_state(steps[count], TRACE_LINE);
+	}
+	return count;
+}
+
+/*
+	The golden file holds every step of two passes through the trace
+	kernel. A longer run, enough for the threaded-code runner to translate
+	the loop, is then repeated in full blocks, and the state at every block
+	boundary has to match the step with the same instruction count.
+*/
+static int trace(const char *file, int write)
+{
+	char (*steps)[TRACE_LINE] = (char (*)[TRACE_LINE])calloc(TRACE_MAX_STEPS, TRACE_LINE);
+	char line[TRACE_LINE], golden[TRACE_LINE];
+	UINT64 count;
+	int errors = 0;
+	FILE *f;
+
+	count = trace_steps(2, steps);
+	if (!(f = fopen(file, write ? "w" : "r")))
+	{
+		perror(file);
+		return 1;
+	}
+	for (UINT64 i = 1; i <= count; i++)
+	{
+		if (write)
+			fprintf(f, "%s\n", steps[i]);
+		else if (!fgets(golden, sizeof(golden), f) || (golden[strcspn(golden, "\n")] = 0, strcmp(golden, steps[i])))
+		{
+			printf("step %llu differs\n  golden: %s\n  core:   %s\n", i, golden, steps[i]);
+			errors++;
+			break;
+		}
+	}
+	snprintf(line, sizeof(line), "end steps=%llu mem=%08x in=%u out=%u", count, memory_hash(), port_reads, port_writes);
+	if (write)
+		fprintf(f, "%s\n", line);
+	else if (!errors && (!fgets(golden, sizeof(golden), f) || (golden[strcspn(golden, "\n")] = 0, strcmp(golden, line))))
+	{
+		printf("end state differs\n  golden: %s\n  core:   %s\n", golden, line);
+		errors++;
+	}
+	fclose(f);
+
+	/* blocks against single steps */
+	count = trace_steps(32, steps);
+	UINT32 hash = memory_hash();
+	machine_reset(k_trace, sizeof(k_trace));
+	REG16(BX) = 32;
+	UINT64 block_count = 0;
+	while (!machine_stopped() && !errors)
+	{
+		block_count += i386_execute_block(I386_BBC_MAX_RUN);
+		if (block_count > count)
+			fatalerror("block run went past the end of the trace\n");
+		trace_state(line, sizeof(line));
+		if (strcmp(line, steps[block_count]))
+		{
+			printf("block boundary at step %llu differs\n  step:  %s\n  block: %s\n", block_count, steps[block_count], line);
+			errors++;
+		}
+	}
+	if (!errors && (block_count != count || memory_hash() != hash))
+	{
+		printf("block run ended after %llu instructions with mem=%08x\n", block_count, memory_hash());
+		errors++;
+	}
+
+	free(steps);
+	if (!errors)
+		printf("trace: ok, %llu steps checked against blocks\n", count);
+	return errors ? 1 : 0;
+}
+
+/* ----------------------------------------------------------------------------
+	x87 host fast path against SoftFloat
+---------------------------------------------------------------------------- */
+
+static UINT64 rng_state = 0x9e3779b97f4a7c15ULL;
+
+static UINT64 rng()
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+/* Random exponent, weighted towards both ends of the range where the host
+   format runs out before the x87 one does */
+static int random_exponent(int min, int max)
+{
+	switch (rng() & 3)
+	{
+		case 0:  return min + (int)(rng() % 24);
+		case 1:  return max - (int)(rng() % 24);
+		case 2:  return (int)(rng() % 61) - 30;
+		default: return min + (int)(rng() % (max - min + 1));
+	}
+}
+
+/* Random pair of operands exactly representable with the given precision.
+   Products and quotients are often steered to land near the smallest normal
+   and differences to cancel. */
+static void x87_operands(int op, int single, floatx80 *a, floatx80 *b)
+{
+	const int min = single ? -126 : -1022, max = single ? 127 : 1023;
+	const int bits = single ? 23 : 52;
+	const UINT64 mask = (U64(1) << bits) - 1;
+	int ea = random_exponent(min, max), eb = random_exponent(min, max);
+	UINT64 ma = rng() & mask, mb = rng() & mask;
+
+	switch (rng() & 3)
+	{
+		case 0:
+			/* significands just below a power of two give results just
+			   below the smallest normal, which the host rounds up to it */
+			if (op == X87_HOST_MUL)
+			{
+				eb = min - ea + (int)(rng() % 5) - 2;
+				if (rng() & 1)
+				{
+					ma = mask - (rng() & 3);
+					mb = rng() & 3;
+				}
+			}
+			else if (op == X87_HOST_DIV)
+			{
+				eb = ea - min + (int)(rng() % 5) - 2;
+				if (rng() & 1)
+				{
+					ma = mask - (rng() & 3);
+					mb = rng() & 1;
+				}
+			}
+			else
+			{
+				eb = ea;
+				mb = ma ^ (rng() & 0xf);
+			}
+			if (eb < min || eb > max)
+				eb = random_exponent(min, max);
+			break;
+		case 1:
+			/* significands of all ones round up most often */
+			ma |= mask & ~(U64(0xff) << (rng() % bits));
+			break;
+	}
+
+	if (single)
+	{
+		*a = float32_to_floatx80((float32)(((rng() & 1) << 31) | ((UINT32)(ea + 127) << 23) | ma));
+		*b = float32_to_floatx80((float32)(((rng() & 1) << 31) | ((UINT32)(eb + 127) << 23) | mb));
+	}
+	else
+	{
+		*a = float64_to_floatx80((float64)(((rng() & 1) << 63) | ((UINT64)(ea + 1023) << 52) | ma));
+		*b = float64_to_floatx80((float64)(((rng() & 1) << 63) | ((UINT64)(eb + 1023) << 52) | mb));
+	}
+}
+
+/*
+	Every result x87_host_op() accepts has to be bit-identical to SoftFloat's
+	floatx80 operation rounded to the same precision, which models the x87
+	with its full exponent range, and has to raise inexact the same way.
+*/
+static int x87_conformance(UINT32 count)
+{
+#ifdef X87_HOST_FPU
+	static const char *const names[] = { "add", "sub", "mul", "div" };
+	int errors = 0;
+
+	for (int single = 0; single < 2; single++)
+	{
+		m_x87_cw = single ? 0x007f : 0x027f;
+		for (int op = X87_HOST_ADD; op <= X87_HOST_DIV; op++)
+		{
+			UINT32 accepted = 0, mismatches = 0;
+
+			for (UINT32 i = 0; i < count; i++)
+			{
+				floatx80 a, b, host, soft;
+				int8 host_flags;
+
+				x87_operands(op, single, &a, &b);
+				float_exception_flags = 0;
+				if (!x87_host_op(op, a, b, &host))
+					continue;
+				accepted++;
+				host_flags = float_exception_flags & float_flag_inexact;
+
+				float_exception_flags = 0;
+				floatx80_rounding_precision = single ? 32 : 64;
+				switch (op)
+				{
+					case X87_HOST_ADD: soft = floatx80_add(a, b); break;
+					case X87_HOST_SUB: soft = floatx80_sub(a, b); break;
+					case X87_HOST_MUL: soft = floatx80_mul(a, b); break;
+					default:           soft = floatx80_div(a, b); break;
+				}
+				floatx80_rounding_precision = 80;
+
+				if (host.high != soft.high || host.low != soft.low || host_flags != (float_exception_flags & float_flag_inexact))
+				{
+					mismatches++;
+					if (errors++ < 10)
+						printf("%s%s %04x:%016llx, %04x:%016llx: host %04x:%016llx, softfloat %04x:%016llx%s\n",
+							names[op], single ? "/24" : "/53", a.high, a.low, b.high, b.low,
+							host.high, host.low, soft.high, soft.low,
+							host_flags != (float_exception_flags & float_flag_inexact) ? " (inexact differs)" : "");
+				}
+			}
+			printf("x87 %s/%d: %u of %u taken by the host, %u mismatches\n", names[op], single ? 24 : 53, accepted, count, mismatches);
+		}
+	}
+	x87_reset();
+	if (errors)
+		printf("x87: %d mismatches\n", errors);
+	return errors ? 1 : 0;
+#else
+	printf("x87: the host fast path is not built on this target\n");
+	return 0;
+#endif
+}
+
+/* ----------------------------------------------------------------------------
+	main
+---------------------------------------------------------------------------- */
+
+static int usage()
+{
+	fprintf(stderr, "usage: vm86bench [-v] [-hostfpu] [-n count] bench [name...]\n"
+			"       vm86bench trace [-write] file\n"
+			"       vm86bench x87 [count]\n");
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	UINT32 scale = 1000;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++)
+	{
+		if (!strcmp(argv[i], "-hostfpu"))
+			x87_host_fpu = true;
+		else if (!strcmp(argv[i], "-v"))
+			verbose = true;
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			scale = strtoul(argv[++i], NULL, 0);
+		else
+			return usage();
+	}
+	if (i >= argc)
+		return usage();
+
+	machine_init();
+	if (!strcmp(argv[i], "bench"))
+		return bench(argc - i - 1, argv + i + 1, scale);
+	if (!strcmp(argv[i], "trace"))
+	{
+		int write = i + 1 < argc && !strcmp(argv[i + 1], "-write");
+
+		if (i + 1 + write >= argc)
+			return usage();
+		return trace(argv[i + 1 + write], write);
+	}
+	if (!strcmp(argv[i], "x87"))
+		return x87_conformance(i + 1 < argc ? strtoul(argv[i + 1], NULL, 0) : 1000000);
+	return usage();
+}
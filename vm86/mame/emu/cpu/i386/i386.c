@@ -38,6 +38,7 @@ static void i386_task_switch(UINT16 selector, UINT8 nested);
 static void build_opcode_table(UINT32 features);
 static void zero_state();
 static void pentium_smi();
+static void i386_bbc_flush();
 
 #define FAULT(fault,error) {m_ext = 1; i386_trap_with_error(fault,0,0,error); return;}
 #define FAULT_EXP(fault,error) {m_ext = 1; i386_trap_with_error(fault,0,trap_level+1,error); return;}
@@ -957,34 +958,28 @@ static void i386_trap(int irq, int irq_gate, int trap_level)
 				}
 			}
 		}
-		UINT32 tempSP = REG32(ESP);
-		try
+		m_fault_esp = REG32(ESP);
+		m_fault_restore |= I386_FAULT_RESTORE_ESP;
+		// this is ugly but the alternative is worse
+		if(type != 0x0e && type != 0x0f)  // if not 386 interrupt or trap gate
 		{
-			// this is ugly but the alternative is worse
-			if(type != 0x0e && type != 0x0f)  // if not 386 interrupt or trap gate
-			{
-				PUSH16(oldflags & 0xffff );
-				PUSH16(m_sreg[CS].selector );
-				if(irq == 3 || irq == 4 || irq == 9 || irq_gate == 1)
-					PUSH16(m_eip );
-				else
-					PUSH16(m_prev_eip );
-			}
+			PUSH16(oldflags & 0xffff );
+			PUSH16(m_sreg[CS].selector );
+			if(irq == 3 || irq == 4 || irq == 9 || irq_gate == 1)
+				PUSH16(m_eip );
 			else
-			{
-				PUSH32(oldflags & 0x00ffffff );
-				PUSH32(m_sreg[CS].selector );
-				if(irq == 3 || irq == 4 || irq == 9 || irq_gate == 1)
-					PUSH32(m_eip );
-				else
-					PUSH32(m_prev_eip );
-			}
+				PUSH16(m_prev_eip );
 		}
-		catch(UINT64 e)
+		else
 		{
-			REG32(ESP) = tempSP;
-			throw e;
+			PUSH32(oldflags & 0x00ffffff );
+			PUSH32(m_sreg[CS].selector );
+			if(irq == 3 || irq == 4 || irq == 9 || irq_gate == 1)
+				PUSH32(m_eip );
+			else
+				PUSH32(m_prev_eip );
 		}
+		m_fault_restore &= ~I386_FAULT_RESTORE_ESP;
 		if(SetRPL != 0)
 			segment = (segment & ~0x03) | m_CPL;
 		m_sreg[CS].selector = segment;
@@ -1969,36 +1964,30 @@ static void i386_protected_mode_call(UINT16 seg, UINT32 off, int indirect, int o
 	if(SetRPL != 0)
 		selector = (selector & ~0x03) | m_CPL;
 
-	UINT32 tempSP = REG32(ESP);
-	try
+	m_fault_esp = REG32(ESP);
+	m_fault_restore |= I386_FAULT_RESTORE_ESP;
+	// this is ugly but the alternative is worse
+	if(operand32 == 0)
 	{
-		// this is ugly but the alternative is worse
-		if(operand32 == 0)
-		{
-			/* 16-bit operand size */
-			PUSH16(m_sreg[CS].selector );
-			PUSH16(m_eip & 0x0000ffff );
-			m_sreg[CS].selector = selector;
-			m_performed_intersegment_jump = 1;
-			m_eip = offset;
-			i386_load_segment_descriptor(CS);
-		}
-		else
-		{
-			/* 32-bit operand size */
-			PUSH32(m_sreg[CS].selector );
-			PUSH32(m_eip );
-			m_sreg[CS].selector = selector;
-			m_performed_intersegment_jump = 1;
-			m_eip = offset;
-			i386_load_segment_descriptor(CS );
-		}
+		/* 16-bit operand size */
+		PUSH16(m_sreg[CS].selector );
+		PUSH16(m_eip & 0x0000ffff );
+		m_sreg[CS].selector = selector;
+		m_performed_intersegment_jump = 1;
+		m_eip = offset;
+		i386_load_segment_descriptor(CS);
 	}
-	catch(UINT64 e)
+	else
 	{
-		REG32(ESP) = tempSP;
-		throw e;
+		/* 32-bit operand size */
+		PUSH32(m_sreg[CS].selector );
+		PUSH32(m_eip );
+		m_sreg[CS].selector = selector;
+		m_performed_intersegment_jump = 1;
+		m_eip = offset;
+		i386_load_segment_descriptor(CS );
 	}
+	m_fault_restore &= ~I386_FAULT_RESTORE_ESP;
 
 	CHANGE_PC(m_eip);
 }
@@ -3360,40 +3349,394 @@ static void i386_set_a20_line(int state)
 	}
 	// TODO: how does A20M and the tlb interact
 	vtlb_flush_dynamic(m_vtlb);
+	i386_bbc_flush();
 }
 
-static CPU_EXECUTE( i386 )
+/*************************************************************************/
+/* Decoded instruction cache
+
+   The prefix and opcode bytes of an instruction are decoded once and kept by
+   linear address, so the next time execution gets there the handler is called
+   directly with the prefix state restored.  Entries are compared against the
+   bytes in memory before use: code segments are also written by the host side
+   (NE loader, selector aliases) without going through WRITE8() and friends,
+   so watching guest writes alone is not enough.
+
+   i386_execute_block() keeps running from the cache as long as execution stays
+   in the same code segment, so vm86main only has to look at the CPU state on
+   far transfers, interrupts and the batch boundaries below. */
+
+#define I386_BBC_SIZE           8192
+#define I386_BBC_MAX_BYTES      4
+#define I386_BBC_MAX_RUN        1024
+
+#define I386_BBC_CODE32         0x01
+#define I386_BBC_OPERAND_PREFIX 0x02
+#define I386_BBC_ADDRESS_PREFIX 0x04
+#define I386_BBC_SEGMENT_PREFIX 0x08
+#define I386_BBC_BRANCH         0x10
+#define I386_BBC_NEAR_BRANCH    0x20
+
+static I386_BBC_ENTRY i386_bbc[I386_BBC_SIZE];
+
+/* Batch boundaries. vm86main sets the return address of the current call
+   before it runs a batch, m_batch_break is raised from other threads when a
+   callback is waiting to be injected and m_batch_pending points at the
+   V8086 pending flags, which are also set asynchronously. */
+static volatile UINT32 m_batch_break;
+static volatile UINT32 *m_batch_pending;
+static UINT16 m_batch_stop_cs;
+static UINT16 m_batch_stop_ip;
+
+INLINE int i386_batch_boundary()
 {
-#ifdef SUPPORT_RDTSC
-	m_cycles = 1;
-	int cycles = m_cycles;
-	m_base_cycles = cycles;
-#endif
-	CHANGE_PC(m_eip);
+	if (m_batch_break && m_IF)
+		return 1;
+	if ((UINT16)m_eip == m_batch_stop_ip && m_sreg[CS].selector == m_batch_stop_cs)
+		return 1;
+	if (V8086_MODE)
+	{
+		UINT8 op;
+
+		if (m_batch_pending && (*m_batch_pending & 0x100000))  // VIP
+			return 1;
+		/* vm86main handles software interrupts in V8086 mode itself */
+		op = read_decrypted_byte(m_pc & m_a20_mask);
+		if (op == 0xcd || op == 0xcc || op == 0xf1)
+			return 1;
+	}
+	return 0;
+}
 
-//	if (m_halted)
-//	{
-//		m_tsc += cycles;
-//		m_cycles = 0;
-//		return;
-//	}
+/* Opcodes that may leave straight-line code or change state vm86main looks at.
+   Near branches stay in the code segment and only end a block when they land
+   on a batch boundary. */
+static UINT8 i386_bbc_branch_type(UINT8 opcode)
+{
+	if (opcode >= 0x70 && opcode <= 0x7f)   // jcc
+		return I386_BBC_NEAR_BRANCH;
+	if (opcode >= 0xe0 && opcode <= 0xe3)   // loop, jcxz
+		return I386_BBC_NEAR_BRANCH;
+	switch (opcode)
+	{
+		case 0xc2:  // ret
+		case 0xc3:
+		case 0xe8:  // call
+		case 0xe9:  // jmp
+		case 0xeb:
+			return I386_BBC_NEAR_BRANCH;
+		case 0x0f:  // two byte opcodes, decoded by the handler
+		case 0x17:  // pop ss
+		case 0x8e:  // mov sreg
+		case 0x9a:  // call far
+		case 0x9d:  // popf
+		case 0xca:  // retf
+		case 0xcb:
+		case 0xcc:  // int3
+		case 0xcd:  // int
+		case 0xce:  // into
+		case 0xcf:  // iret
+		case 0xea:  // jmp far
+		case 0xf0:  // lock
+		case 0xf1:  // icebp
+		case 0xf2:  // repne
+		case 0xf3:  // rep
+		case 0xf4:  // hlt
+		case 0xfa:  // cli
+		case 0xfb:  // sti
+		case 0xff:  // call/jmp indirect
+			return I386_BBC_BRANCH;
+	}
+	return 0;
+}
 
-//	while( m_cycles > 0 )
-//	{
-		i386_check_irq_line();
-		m_operand_size = m_sreg[CS].d;
-		m_xmm_operand_size = 0;
-		m_address_size = m_sreg[CS].d;
-		m_operand_prefix = 0;
-		m_address_prefix = 0;
+static bool i386_bbc_decode(I386_BBC_ENTRY *entry, UINT32 pc)
+{
+	UINT8 state = m_sreg[CS].d ? I386_BBC_CODE32 : 0;
+	UINT8 segment_override = 0;
+	UINT8 opcode = 0, prev = 0;
+	int length = 0;
+	int operand_size;
+
+	entry->length = 0;
+	for (;;)
+	{
+		if (length == I386_BBC_MAX_BYTES)
+			return false;
+		prev = opcode;
+		opcode = read_decrypted_byte((pc + length) & m_a20_mask);
+		entry->bytes[length++] = opcode;
+		switch (opcode)
+		{
+			case 0x26: segment_override = ES; state |= I386_BBC_SEGMENT_PREFIX; continue;
+			case 0x2e: segment_override = CS; state |= I386_BBC_SEGMENT_PREFIX; continue;
+			case 0x36: segment_override = SS; state |= I386_BBC_SEGMENT_PREFIX; continue;
+			case 0x3e: segment_override = DS; state |= I386_BBC_SEGMENT_PREFIX; continue;
+			case 0x64: segment_override = FS; state |= I386_BBC_SEGMENT_PREFIX; continue;
+			case 0x65: segment_override = GS; state |= I386_BBC_SEGMENT_PREFIX; continue;
+			case 0x66: state |= I386_BBC_OPERAND_PREFIX; continue;
+			case 0x67: state |= I386_BBC_ADDRESS_PREFIX; continue;
+		}
+		break;
+	}
+
+	operand_size = ((state & I386_BBC_CODE32) ? 1 : 0) ^ ((state & I386_BBC_OPERAND_PREFIX) ? 1 : 0);
+	/* I386OP(operand_size) dispatches 66 0f itself */
+	if (prev == 0x66 && length > 1 && opcode == 0x0f)
+		entry->handler = I386OP(decode_three_byte66);
+	else if (operand_size)
+		entry->handler = m_opcode_table1_32[opcode];
+	else
+		entry->handler = m_opcode_table1_16[opcode];
+	state |= i386_bbc_branch_type(opcode);
+
+	entry->pc = pc;
+	entry->opcode = opcode;
+	entry->state = state;
+	entry->segment_override = segment_override;
+	entry->length = length;
+	return true;
+}
+
+INLINE I386_BBC_ENTRY *i386_bbc_lookup(UINT32 pc)
+{
+	I386_BBC_ENTRY *entry = &i386_bbc[(pc ^ (pc >> 13)) & (I386_BBC_SIZE - 1)];
+	UINT8 code32 = m_sreg[CS].d ? I386_BBC_CODE32 : 0;
+	int i;
+
+	if (entry->length && entry->pc == pc && (entry->state & I386_BBC_CODE32) == code32)
+	{
+		for (i = 0; i < entry->length; i++)
+		{
+			if (read_decrypted_byte((pc + i) & m_a20_mask) != entry->bytes[i])
+				break;
+		}
+		if (i == entry->length)
+			return entry;
+	}
+	return i386_bbc_decode(entry, pc) ? entry : NULL;
+}
+
+static void i386_bbc_flush()
+{
+	memset(i386_bbc, 0, sizeof(i386_bbc));
+}
+
+#ifdef VM86_THREADED_CODE
+/*************************************************************************/
+/* Threaded code
+
+   Code that keeps coming back to the same linear address is translated into
+   a trace: the decoded handlers of the following instructions, laid out in
+   order with their lengths, up to the first unconditional control transfer.
+   Running a trace costs one lookup and one compare of the code bytes, after
+   that the handlers are called back to back.  Every handler is checked to
+   have fallen through to the next instruction of the trace, so taken
+   branches, traps and faults leave the trace at the right place. */
+
+#define I386_TC_SIZE            1024
+#define I386_TC_MAX_INSNS       32
+#define I386_TC_MAX_BYTES       128
+#define I386_TC_THRESHOLD       16
+#define I386_TC_UNTRANSLATABLE  0xffff
+
+struct I386_TC_TRACE {
+	UINT32 pc;
+	UINT16 hits;
+	UINT8 code32;
+	UINT8 count;
+	UINT16 bytes;
+	UINT8 code[I386_TC_MAX_BYTES];
+	I386_TC_OP ops[I386_TC_MAX_INSNS];
+};
+
+static I386_TC_TRACE i386_tc[I386_TC_SIZE];
+
+/* conditional branches may stay inside a trace, the fall through is checked at run time */
+static int i386_tc_ends_trace(const I386_BBC_ENTRY *entry)
+{
+	if (!(entry->state & (I386_BBC_BRANCH | I386_BBC_NEAR_BRANCH)))
+		return 0;
+	if (entry->opcode >= 0x70 && entry->opcode <= 0x7f)
+		return 0;
+	if (entry->opcode >= 0xe0 && entry->opcode <= 0xe3)
+		return 0;
+	if (entry->opcode == 0x0f)
+		return 0;
+	return 1;
+}
+
+static void i386_tc_translate(I386_TC_TRACE *trace, UINT32 pc)
+{
+	char buffer[256];
+	UINT32 offset = 0;
+	int count = 0;
+	int mode = m_sreg[CS].d ? 32 : 16;
+
+	while (count < I386_TC_MAX_INSNS)
+	{
+		I386_BBC_ENTRY entry;
+		I386_TC_OP *op;
+		int size;
 
+		/* the disassembler may look at up to 15 bytes, stay inside the segment */
+		if (m_sreg[CS].limit < 15 || m_eip + offset > m_sreg[CS].limit - 15)
+			break;
+		if (!i386_bbc_decode(&entry, pc + offset))
+			break;
+		size = i386_dasm_one(buffer, m_eip + offset, mem + ((pc + offset) & m_a20_mask), mode) & DASMFLAG_LENGTHMASK;
+		if (size < entry.length || offset + size > I386_TC_MAX_BYTES)
+			break;
+
+		op = &trace->ops[count++];
+		op->handler = entry.handler;
+		op->length = entry.length;
+		op->size = size;
+		op->opcode = entry.opcode;
+		op->state = entry.state;
+		op->segment_override = entry.segment_override;
+		offset += size;
+		if (i386_tc_ends_trace(&entry))
+			break;
+	}
+
+	for (UINT32 i = 0; i < offset; i++)
+		trace->code[i] = read_decrypted_byte((pc + i) & m_a20_mask);
+	trace->bytes = offset;
+	trace->count = count;
+	if (!count)
+		trace->hits = I386_TC_UNTRANSLATABLE;
+}
+
+static I386_TC_TRACE *i386_tc_lookup(UINT32 pc)
+{
+	I386_TC_TRACE *trace = &i386_tc[(pc ^ (pc >> 10)) & (I386_TC_SIZE - 1)];
+	UINT8 code32 = m_sreg[CS].d ? 1 : 0;
+
+	if (trace->pc != pc || trace->code32 != code32)
+	{
+		trace->pc = pc;
+		trace->code32 = code32;
+		trace->hits = 1;
+		trace->count = 0;
+		return NULL;
+	}
+	if (!trace->count)
+	{
+		if (trace->hits == I386_TC_UNTRANSLATABLE || ++trace->hits < I386_TC_THRESHOLD)
+			return NULL;
+		i386_tc_translate(trace, pc);
+		return trace->count ? trace : NULL;
+	}
+	if (memcmp(trace->code, mem + (pc & m_a20_mask), trace->bytes))
+	{
+		/* the code was patched, translate it again */
+		i386_tc_translate(trace, pc);
+		return trace->count ? trace : NULL;
+	}
+	return trace;
+}
+
+static int i386_tc_run(const I386_TC_TRACE *trace)
+{
+	UINT16 cs = m_sreg[CS].selector;
+	jmp_buf *outer_fault_jmp = m_fault_jmp;
+	jmp_buf fault_jmp;
+	volatile int i = 0;
+
+	CHANGE_PC(m_eip);
+	m_fault_restore = 0;
+	m_fault_jmp = &fault_jmp;
+	if (setjmp(fault_jmp))
+	{
+		m_fault_jmp = outer_fault_jmp;
+		i386_fault_unwind();
 		m_ext = 1;
-		int old_tf = m_TF;
+		i386_trap_with_error(m_fault&0xffffffff,0,0,m_fault>>32);
+		return i;
+	}
+	i386_check_irq_line();
+	while (i < trace->count)
+	{
+		const I386_TC_OP *op = &trace->ops[i++];
+		UINT8 state = op->state;
+		UINT32 next = m_eip + op->size;
 
-		m_segment_prefix = 0;
+		m_ext = 1;
 		m_prev_eip = m_eip;
+		m_operand_size = ((state & I386_BBC_CODE32) ? 1 : 0) ^ ((state & I386_BBC_OPERAND_PREFIX) ? 1 : 0);
+		m_xmm_operand_size = (state & I386_BBC_OPERAND_PREFIX) ? 1 : 0;
+		m_address_size = ((state & I386_BBC_CODE32) ? 1 : 0) ^ ((state & I386_BBC_ADDRESS_PREFIX) ? 1 : 0);
+		m_operand_prefix = (state & I386_BBC_OPERAND_PREFIX) ? 1 : 0;
+		m_address_prefix = (state & I386_BBC_ADDRESS_PREFIX) ? 1 : 0;
+		m_segment_prefix = (state & I386_BBC_SEGMENT_PREFIX) ? 1 : 0;
+		m_segment_override = op->segment_override;
+		m_opcode = op->opcode;
+		m_eip += op->length;
+		m_pc += op->length;
+		op->handler();
+		if(m_lock && (m_opcode != 0xf0))
+			m_lock = false;
+
+		if (m_eip != next || m_sreg[CS].selector != cs)
+			break;
+		if (m_TF || m_halted || m_delayed_interrupt_enable)
+			break;
+	}
+	m_fault_jmp = outer_fault_jmp;
+	return i;
+}
+#endif
+
+/* Instructions without prefixes in code of the default size need none of
+   the per-instruction mode setup, and the default size can't change without
+   leaving the block, so the loop is instantiated once for 16-bit and once
+   for 32-bit code segments. */
+template <int CODE32>
+static void I386OP(decode_opcode_sized)()
+{
+	m_opcode = FETCH();
+
+	if(m_lock && !m_lock_table[0][m_opcode])
+		return I386OP(invalid)();
+
+	if( CODE32 )
+		m_opcode_table1_32[m_opcode]();
+	else
+		m_opcode_table1_16[m_opcode]();
+}
+
+template <int CODE32>
+static int i386_execute_block_sized(int max_insns)
+{
+	const UINT8 prefixes = I386_BBC_OPERAND_PREFIX | I386_BBC_ADDRESS_PREFIX | I386_BBC_SEGMENT_PREFIX;
+	jmp_buf *outer_fault_jmp = m_fault_jmp;
+	jmp_buf fault_jmp;
+	volatile int count = 0;
+
+	m_fault_restore = 0;
+	m_fault_jmp = &fault_jmp;
+	if (setjmp(fault_jmp))
+	{
+		m_fault_jmp = outer_fault_jmp;
+		i386_fault_unwind();
+		m_ext = 1;
+		i386_trap_with_error(m_fault&0xffffffff,0,0,m_fault>>32);
+		return count + 1;
+	}
+	for (;;)
+	{
+		I386_BBC_ENTRY *entry = NULL;
+		UINT16 cs = m_sreg[CS].selector;
+		UINT32 eip = m_eip;
+		bool branch = true;
+		UINT8 near_branch = 0;
+		int old_tf;
 
-//		debugger_instruction_hook(device, m_pc);
+		i386_check_irq_line();
+		m_ext = 1;
+		old_tf = m_TF;
+		m_prev_eip = m_eip;
 
 		if(m_delayed_interrupt_enable != 0)
 		{
@@ -3404,27 +3747,95 @@ static CPU_EXECUTE( i386 )
 		m_opcode_bytes_length = 0;
 		m_opcode_pc = m_pc;
 #endif
-		try
+		if (!m_lock)
+			entry = i386_bbc_lookup(m_pc);
+		if (entry && !(entry->state & prefixes))
 		{
-			I386OP(decode_opcode)();
-			if(m_TF && old_tf)
-			{
-				m_prev_eip = m_eip;
-				m_ext = 1;
-				i386_trap(1,0,0);
-			}
-			if(m_lock && (m_opcode != 0xf0))
-				m_lock = false;
+			m_operand_size = CODE32;
+			m_xmm_operand_size = 0;
+			m_address_size = CODE32;
+			m_operand_prefix = 0;
+			m_address_prefix = 0;
+			m_segment_prefix = 0;
+			m_opcode = entry->opcode;
+			m_eip += entry->length;
+			m_pc += entry->length;
+			branch = (entry->state & I386_BBC_BRANCH) ? true : false;
+			near_branch = entry->state & I386_BBC_NEAR_BRANCH;
+			entry->handler();
+		}
+		else if (entry)
+		{
+			UINT8 state = entry->state;
+
+			m_operand_size = CODE32 ^ ((state & I386_BBC_OPERAND_PREFIX) ? 1 : 0);
+			m_xmm_operand_size = (state & I386_BBC_OPERAND_PREFIX) ? 1 : 0;
+			m_address_size = CODE32 ^ ((state & I386_BBC_ADDRESS_PREFIX) ? 1 : 0);
+			m_operand_prefix = (state & I386_BBC_OPERAND_PREFIX) ? 1 : 0;
+			m_address_prefix = (state & I386_BBC_ADDRESS_PREFIX) ? 1 : 0;
+			m_segment_prefix = (state & I386_BBC_SEGMENT_PREFIX) ? 1 : 0;
+			m_segment_override = entry->segment_override;
+			m_opcode = entry->opcode;
+			m_eip += entry->length;
+			m_pc += entry->length;
+			branch = (state & I386_BBC_BRANCH) ? true : false;
+			near_branch = state & I386_BBC_NEAR_BRANCH;
+			entry->handler();
 		}
-		catch(UINT64 e)
+		else
 		{
+			m_operand_size = CODE32;
+			m_xmm_operand_size = 0;
+			m_address_size = CODE32;
+			m_operand_prefix = 0;
+			m_address_prefix = 0;
+			m_segment_prefix = 0;
+			I386OP(decode_opcode_sized)<CODE32>();
+		}
+		if(m_TF && old_tf)
+		{
+			m_prev_eip = m_eip;
 			m_ext = 1;
-			i386_trap_with_error(e&0xffffffff,0,0,e>>32);
+			i386_trap(1,0,0);
 		}
-//	}
-#ifdef SUPPORT_RDTSC
-	m_tsc += (cycles - m_cycles);
+		if(m_lock && (m_opcode != 0xf0))
+			m_lock = false;
+
+		count++;
+		if (branch || m_TF || m_halted || count >= max_insns)
+			break;
+		/* faults and invalid opcodes that trap don't fall through */
+		if (m_sreg[CS].selector != cs || m_sreg[CS].d != CODE32)
+			break;
+		if (!near_branch && m_eip - eip - 1 >= 15)
+			break;
+		if (i386_batch_boundary())
+			break;
+	}
+	m_fault_jmp = outer_fault_jmp;
+	return count;
+}
+
+/* Runs at most max_insns instructions and returns how many were executed.
+   Stops early on far transfers, interrupts, faults and the batch boundaries
+   above, so vm86main only has to check its state between batches. */
+static int i386_execute_block(int max_insns)
+{
+#ifdef VM86_THREADED_CODE
+	if (max_insns > 1 && !m_lock && !m_TF && !m_delayed_interrupt_enable && !V8086_MODE)
+	{
+		const I386_TC_TRACE *trace;
+
+		CHANGE_PC(m_eip);
+		trace = i386_tc_lookup(m_pc);
+		if (trace)
+			return i386_tc_run(trace);
+	}
 #endif
+	CHANGE_PC(m_eip);
+	if (m_sreg[CS].d)
+		return i386_execute_block_sized<1>(max_insns);
+	return i386_execute_block_sized<0>(max_insns);
 }
 
 /*************************************************************************/
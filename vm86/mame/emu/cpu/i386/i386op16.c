@@ -1682,22 +1682,16 @@ static void I386OP(pop_rm16)()          // Opcode 0x8f
 
 	if(i386_limit_check(SS,offset+1) == 0)
 	{
-		UINT32 temp_sp = REG32(ESP);
+		m_fault_esp = REG32(ESP);
 		value = POP16();
 
 		if( modrm >= 0xc0 ) {
 			STORE_RM16(modrm, value);
 		} else {
-			try
-			{
-				ea = GetEA(modrm,1);
-				WRITE16(ea, value);
-			}
-			catch(UINT64 e)
-			{
-				REG32(ESP) = temp_sp;
-				throw e;
-			}
+			m_fault_restore |= I386_FAULT_RESTORE_ESP;
+			ea = GetEA(modrm,1);
+			WRITE16(ea, value);
+			m_fault_restore &= ~I386_FAULT_RESTORE_ESP;
 		}
 	}
 	else
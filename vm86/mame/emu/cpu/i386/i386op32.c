@@ -1535,22 +1535,16 @@ static void I386OP(pop_rm32)()          // Opcode 0x8f
 		// be careful here, if the write references the esp register
 		// it expects the post-pop value but esp must be wound back
 		// if the write faults
-		UINT32 temp_sp = REG32(ESP);
+		m_fault_esp = REG32(ESP);
 		value = POP32();
 
 		if( modrm >= 0xc0 ) {
 			STORE_RM32(modrm, value);
 		} else {
-			try
-			{
-				ea = GetEA(modrm,1);
-				WRITE32(ea, value);
-			}
-			catch(UINT64 e)
-			{
-				REG32(ESP) = temp_sp;
-				throw e;
-			}
+			m_fault_restore |= I386_FAULT_RESTORE_ESP;
+			ea = GetEA(modrm,1);
+			WRITE32(ea, value);
+			m_fault_restore &= ~I386_FAULT_RESTORE_ESP;
 		}
 	}
 	else
@@ -1089,6 +1089,171 @@ static void I386OP(outsd)()             // Opcode 0x6f
 	I386OP(outs_generic)(4);
 }
 
+/* Checks that [offset, offset + length) lies inside the segment without
+   wrapping and returns the host pointer to its start. Segments that need
+   more than a plain limit check are left to the element-wise loop. */
+static int I386OP(rep_range)(int segment, UINT32 offset, UINT64 length, int rwn, UINT8 **ptr)
+{
+	const I386_SREG *seg = &m_sreg[segment];
+	UINT64 last = (UINT64)offset + length - 1;
+
+	if(last > (m_address_size ? 0xffffffff : 0xffff))
+		return 0;
+	if(PROTECTED_MODE && !V8086_MODE)
+	{
+		if(!(seg->valid && (i386_sreg_access[(seg->flags >> 1) & 0x0f] & (1 << rwn)) && last <= seg->limit))
+			return 0;
+	}
+	if((UINT64)seg->base + last > 0xffffffff)
+		return 0;
+	*ptr = mem + seg->base + offset;
+	return 1;
+}
+
+INLINE UINT32 I386OP(rep_load)(const UINT8 *p, int size)
+{
+	switch(size)
+	{
+		case 1: return *p;
+		case 2: return *(UINT16 *)p;
+		default: return *(UINT32 *)p;
+	}
+}
+
+/* Runs a whole REP MOVS/STOS/CMPS/SCAS on host memory. Returns 0 when the
+   string has to go through the element-wise loop instead, either because a
+   segment check could fault part way or because an overlapping MOVS would
+   not behave like memmove. */
+static int I386OP(repeat_bulk)(UINT8 opcode, int invert_flag)
+{
+	UINT32 count = m_address_size ? REG32(ECX) : REG16(CX);
+	int size = (opcode & 1) ? (m_operand_size ? 4 : 2) : 1;
+	UINT64 length = (UINT64)count * size;
+	/* with DF set the string runs downwards from the current element */
+	UINT32 back = m_DF ? (UINT32)(length - size) : 0;
+	UINT32 si = (m_address_size ? REG32(ESI) : REG16(SI)) - back;
+	UINT32 di = (m_address_size ? REG32(EDI) : REG16(DI)) - back;
+	UINT8 *src = NULL, *dst = NULL;
+	UINT32 done, acc, a = 0, b = 0, step;
+	int use_si = 0, compare = 0;
+
+	if(m_a20_mask != 0xffffffff)
+		return 0;
+
+	switch(opcode)
+	{
+		case 0xa4:
+		case 0xa5:
+			if(!I386OP(rep_range)(m_segment_prefix ? m_segment_override : DS, si, length, 0, &src) ||
+					!I386OP(rep_range)(ES, di, length, 1, &dst))
+				return 0;
+			if(m_DF ? (dst < src && dst + length > src) : (dst > src && dst < src + length))
+				return 0;
+			memmove(dst, src, (size_t)length);
+			done = count;
+			use_si = 1;
+			break;
+
+		case 0xaa:
+		case 0xab:
+			if(!I386OP(rep_range)(ES, di, length, 1, &dst))
+				return 0;
+			if(size == 1)
+				memset(dst, REG8(AL), count);
+			else if(size == 2)
+				for(done = 0; done < count; done++)
+					((UINT16 *)dst)[done] = REG16(AX);
+			else
+				for(done = 0; done < count; done++)
+					((UINT32 *)dst)[done] = REG32(EAX);
+			done = count;
+			break;
+
+		case 0xa6:
+		case 0xa7:
+			if(!I386OP(rep_range)(m_segment_prefix ? m_segment_override : DS, si, length, 0, &src) ||
+					!I386OP(rep_range)(ES, di, length, 0, &dst))
+				return 0;
+			if(m_DF)
+			{
+				src += back;
+				dst += back;
+			}
+			for(done = 0; done < count; )
+			{
+				a = I386OP(rep_load)(src, size);
+				b = I386OP(rep_load)(dst, size);
+				done++;
+				if((a == b) == invert_flag)
+					break;
+				src += m_DF ? -size : size;
+				dst += m_DF ? -size : size;
+			}
+			use_si = 1;
+			compare = 1;
+			break;
+
+		case 0xae:
+		case 0xaf:
+			if(!I386OP(rep_range)(ES, di, length, 0, &dst))
+				return 0;
+			acc = size == 1 ? REG8(AL) : size == 2 ? REG16(AX) : REG32(EAX);
+			if(size == 1 && invert_flag && !m_DF)
+			{
+				UINT8 *found = (UINT8 *)memchr(dst, acc, count);
+				done = found ? (UINT32)(found - dst) + 1 : count;
+				b = dst[done - 1];
+			}
+			else
+			{
+				if(m_DF)
+					dst += back;
+				for(done = 0; done < count; )
+				{
+					b = I386OP(rep_load)(dst, size);
+					done++;
+					if((b == acc) == invert_flag)
+						break;
+					dst += m_DF ? -size : size;
+				}
+			}
+			a = acc;
+			compare = 1;
+			break;
+
+		default:
+			return 0;
+	}
+
+	/* flags come from the last element compared, as in the loop */
+	if(compare)
+	{
+		switch(size)
+		{
+			case 1: SUB8(a, b); break;
+			case 2: SUB16(a, b); break;
+			default: SUB32(a, b); break;
+		}
+	}
+
+	step = m_DF ? -(done * size) : done * size;
+	if(m_address_size)
+	{
+		REG32(ECX) -= done;
+		REG32(EDI) += step;
+		if(use_si)
+			REG32(ESI) += step;
+	}
+	else
+	{
+		REG16(CX) -= done;
+		REG16(DI) += step;
+		if(use_si)
+			REG16(SI) += step;
+	}
+	return 1;
+}
+
 static void I386OP(repeat)(int invert_flag)
 {
 	UINT32 repeated_eip = m_eip;
@@ -1098,7 +1263,7 @@ static void I386OP(repeat)(int invert_flag)
 	UINT32 count;
 	INT32 cycle_base = 0, cycle_adjustment = 0;
 	UINT8 prefix_flag=1;
-	UINT8 *flag = NULL;
+	const I386_LAZY_ZF *flag = NULL;
 
 
 	do {
@@ -1242,19 +1407,14 @@ static void I386OP(repeat)(int invert_flag)
 
 	/* now actually perform the repeat */
 	CYCLES_NUM(cycle_base);
+	if(I386OP(repeat_bulk)(opcode, invert_flag))
+		return;
+	m_fault_restore |= I386_FAULT_RESTORE_EIP;
 	do
 	{
 		m_eip = repeated_eip;
 		m_pc = repeated_pc;
-		try
-		{
-			I386OP(decode_opcode)();
-		}
-		catch (UINT64 e)
-		{
-			m_eip = m_prev_eip;
-			throw e;
-		}
+		I386OP(decode_opcode)();
 
 		CYCLES_NUM(cycle_adjustment);
 
@@ -1266,6 +1426,7 @@ static void I386OP(repeat)(int invert_flag)
 //			goto outofcycles;
 	}
 	while( count && (!flag || (invert_flag ? !*flag : *flag)) );
+	m_fault_restore &= ~I386_FAULT_RESTORE_EIP;
 //	return;
 //
 //outofcycles:
@@ -9,6 +9,7 @@
 #include "../../../lib/softfloat/milieu.h"
 #include "../../../lib/softfloat/softfloat.h"
 #include "../vtlb.h"
+#include <setjmp.h>
 
 //#define DEBUG_MISSING_OPCODE
 
@@ -312,6 +313,25 @@ struct I386_SEG_DESC {
 	UINT32 limit;
 };
 
+struct I386_BBC_ENTRY {
+	UINT32 pc;          // linear address of the first prefix byte
+	void (*handler)();
+	UINT8 bytes[4];     // prefix and opcode bytes at decode time
+	UINT8 length;       // number of bytes in bytes[], 0 if the entry is empty
+	UINT8 opcode;
+	UINT8 state;        // I386_BBC_* flags
+	UINT8 segment_override;
+};
+
+struct I386_TC_OP {
+	void (*handler)();
+	UINT8 length;       // prefix and opcode bytes, the handler fetches the rest
+	UINT8 size;         // whole instruction
+	UINT8 opcode;
+	UINT8 state;
+	UINT8 segment_override;
+};
+
 union I386_GPR {
 	UINT32 d[8];
 	UINT16 w[16];
@@ -343,6 +363,41 @@ union XMM_REG {
 	double  f64[2];
 };
 
+extern int i386_parity_table[256];
+
+/* ZF, SF, PF and AF are kept as the value they are derived from and only
+   worked out when an instruction reads them. Most ALU results overwrite
+   them before anyone looks, so SetSZPF* is a couple of stores instead of
+   three compares and a parity table lookup. Assigning 0 or 1 still works
+   as for the other flags. */
+struct I386_LAZY_ZF
+{
+	UINT32 res;
+	operator UINT8() const { return res == 0; }
+	I386_LAZY_ZF &operator=(int v) { res = v ? 0 : 1; return *this; }
+};
+
+struct I386_LAZY_SF
+{
+	UINT32 res;     // result shifted so that its sign is bit 31
+	operator UINT8() const { return res >> 31; }
+	I386_LAZY_SF &operator=(int v) { res = v ? 0x80000000 : 0; return *this; }
+};
+
+struct I386_LAZY_PF
+{
+	UINT8 res;      // low byte of the result
+	operator UINT8() const { return i386_parity_table[res]; }
+	I386_LAZY_PF &operator=(int v) { res = v ? 0 : 1; return *this; }
+};
+
+struct I386_LAZY_AF
+{
+	UINT8 res;      // result ^ src ^ dst
+	operator UINT8() const { return (res >> 4) & 1; }
+	I386_LAZY_AF &operator=(int v) { res = v ? 0x10 : 0; return *this; }
+};
+
 //struct i386_state
 //{
 	I386_GPR m_reg;
@@ -354,11 +409,11 @@ union XMM_REG {
 	UINT32 m_eflags_mask;
 	UINT8 m_CF;
 	UINT8 m_DF;
-	UINT8 m_SF;
+	I386_LAZY_SF m_SF;
 	UINT8 m_OF;
-	UINT8 m_ZF;
-	UINT8 m_PF;
-	UINT8 m_AF;
+	I386_LAZY_ZF m_ZF;
+	I386_LAZY_PF m_PF;
+	I386_LAZY_AF m_AF;
 	UINT8 m_IF;
 	UINT8 m_TF;
 	UINT8 m_IOP1;
@@ -486,10 +541,38 @@ union XMM_REG {
 #endif
 //};
 
-extern int i386_parity_table[256];
 static int i386_limit_check(int seg, UINT32 offset);
 
-#define FAULT_THROW(fault,error) { throw (UINT64)(fault | (UINT64)error << 32); }
+/* Guest faults raised inside i386_execute_block() longjmp back to the
+   buffer the block installed, which is far cheaper than unwinding a C++
+   exception. Outside a block, e.g. when vm86main loads the guest context,
+   there is nothing to jump to and they are thrown as a UINT64 as before. */
+static jmp_buf *m_fault_jmp;
+static UINT64 m_fault;
+
+/* State an instruction has to put back if it faults half way through,
+   undone by whoever catches the fault before the trap is taken */
+#define I386_FAULT_RESTORE_ESP  0x01
+#define I386_FAULT_RESTORE_EIP  0x02
+static UINT8 m_fault_restore;
+static UINT32 m_fault_esp;
+
+#ifdef _MSC_VER
+__declspec(noreturn)
+#else
+__attribute__((noreturn))
+#endif
+static void i386_raise_fault(UINT64 fault)
+{
+	if (m_fault_jmp)
+	{
+		m_fault = fault;
+		longjmp(*m_fault_jmp, 1);
+	}
+	throw fault;
+}
+
+#define FAULT_THROW(fault,error) { i386_raise_fault((UINT64)(fault | (UINT64)error << 32)); }
 #define PF_THROW(error) { m_cr[2] = address; FAULT_THROW(FAULT_PF,error); }
 
 #define PROTECTED_MODE      (m_cr[0] & 0x1)
@@ -512,12 +595,12 @@ static int i386_limit_check(int seg, UINT32 offset);
 
 #define SetSF(x)            (m_SF = (x))
 #define SetZF(x)            (m_ZF = (x))
-#define SetAF(x,y,z)        (m_AF = (((x) ^ ((y) ^ (z))) & 0x10) ? 1 : 0)
-#define SetPF(x)            (m_PF = i386_parity_table[(x) & 0xFF])
+#define SetAF(x,y,z)        (m_AF.res = (UINT8)((x) ^ ((y) ^ (z))))
+#define SetPF(x)            (m_PF.res = (UINT8)(x))
 
-#define SetSZPF8(x)         {m_ZF = ((UINT8)(x)==0);  m_SF = ((x)&0x80) ? 1 : 0; m_PF = i386_parity_table[x & 0xFF]; }
-#define SetSZPF16(x)        {m_ZF = ((UINT16)(x)==0);  m_SF = ((x)&0x8000) ? 1 : 0; m_PF = i386_parity_table[x & 0xFF]; }
-#define SetSZPF32(x)        {m_ZF = ((UINT32)(x)==0);  m_SF = ((x)&0x80000000) ? 1 : 0; m_PF = i386_parity_table[x & 0xFF]; }
+#define SetSZPF8(x)         {m_ZF.res = m_SF.res = (UINT32)(x) << 24; m_PF.res = (UINT8)(x); }
+#define SetSZPF16(x)        {m_ZF.res = m_SF.res = (UINT32)(x) << 16; m_PF.res = (UINT8)(x); }
+#define SetSZPF32(x)        {m_ZF.res = m_SF.res = (UINT32)(x); m_PF.res = (UINT8)(x); }
 
 #define MMX(n)              (*((MMX_REG *)(&m_x87_reg[(n)].low)))
 #define XMM(n)              m_sse_reg[(n)]
@@ -557,26 +640,60 @@ extern MODRM_TABLE i386_MODRM_table[256];
 #define STORE_RM16(x, value)    (REG16(i386_MODRM_table[x].rm.w) = value)
 #define STORE_RM32(x, value)    (REG32(i386_MODRM_table[x].rm.d) = value)
 
+INLINE void i386_fault_unwind()
+{
+	if (m_fault_restore & I386_FAULT_RESTORE_ESP)
+		REG32(ESP) = m_fault_esp;
+	if (m_fault_restore & I386_FAULT_RESTORE_EIP)
+		m_eip = m_prev_eip;
+	m_fault_restore = 0;
+}
+
 #define SWITCH_ENDIAN_32(x) (((((x) << 24) & (0xff << 24)) | (((x) << 8) & (0xff << 16)) | (((x) >> 8) & (0xff << 8)) | (((x) >> 24) & (0xff << 0))))
 
+/* Without paging linear memory is mapped flat, so unaligned accesses don't
+   have to be split into bytes in case they cross into another page. */
+#ifdef PAGING
+#define UNALIGNED_ACCESS(ea, mask)  ((ea) & (mask))
+#else
+#define UNALIGNED_ACCESS(ea, mask)  0
+#endif
+
 /***********************************************************************************/
 
 //
 UINT get_segment_descriptor_wine(int sreg);
 //
+/* Segment types that can be accessed with a plain limit check, indexed by
+   descriptor type bits 1-4.  Bit 0: readable, bit 1: writable.
+   Execute-only code and expand-down data take the slow path. */
+static const UINT8 i386_sreg_access[16] =
+{
+	0x01, 0x03, 0x01, 0x03, 0x00, 0x01, 0x00, 0x01, // system descriptors
+	0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01  // data, expand-down data, code, conforming code
+};
+
+static void i386_translate_check(int segment, UINT32 ip, int rwn)
+{
+	if(!(m_sreg[segment].valid))
+		FAULT_THROW((segment==SS)?FAULT_SS:FAULT_GP, 0);
+	if(i386_limit_check(segment, ip))
+		FAULT_THROW((segment==SS)?FAULT_SS:FAULT_GP, 0);
+	if((rwn == 0) && ((m_sreg[segment].flags & 8) && !(m_sreg[segment].flags & 2)))
+		FAULT_THROW(FAULT_GP, 0);
+	if((rwn == 1) && ((m_sreg[segment].flags & 8) || !(m_sreg[segment].flags & 2)))
+		FAULT_THROW(FAULT_GP, 0);
+}
+
 INLINE UINT32 i386_translate(int segment, UINT32 ip, int rwn)
 {
 	// TODO: segment limit access size, execution permission, handle exception thrown from exception handler
 	if(PROTECTED_MODE && !V8086_MODE && (rwn != -1))
 	{
-		if(!(m_sreg[segment].valid))
-			FAULT_THROW((segment==SS)?FAULT_SS:FAULT_GP, 0);
-		if(i386_limit_check(segment, ip))
-			FAULT_THROW((segment==SS)?FAULT_SS:FAULT_GP, 0);
-		if((rwn == 0) && ((m_sreg[segment].flags & 8) && !(m_sreg[segment].flags & 2)))
-			FAULT_THROW(FAULT_GP, 0);
-		if((rwn == 1) && ((m_sreg[segment].flags & 8) || !(m_sreg[segment].flags & 2)))
-			FAULT_THROW(FAULT_GP, 0);
+		const I386_SREG *seg = &m_sreg[segment];
+
+		if(!(seg->valid && (i386_sreg_access[(seg->flags >> 1) & 0x0f] & (1 << rwn)) && ip <= seg->limit))
+			i386_translate_check(segment, ip, rwn);
 	}
 	//
 	//return get_segment_descriptor_wine(segment) + ip;
@@ -764,7 +881,7 @@ INLINE UINT16 FETCH16()
 	UINT16 value;
 	UINT32 address = m_pc, error;
 
-	if( address & 0x1 ) {       /* Unaligned read */
+	if( UNALIGNED_ACCESS(address, 0x1) ) {       /* Unaligned read */
 		value = (FETCH() << 0);
 		value |= (FETCH() << 8);
 	} else {
@@ -782,7 +899,7 @@ INLINE UINT32 FETCH32()
 	UINT32 value;
 	UINT32 address = m_pc, error;
 
-	if( m_pc & 0x3 ) {      /* Unaligned read */
+	if( UNALIGNED_ACCESS(m_pc, 0x3) ) {      /* Unaligned read */
 		value = (FETCH() << 0);
 		value |= (FETCH() << 8);
 		value |= (FETCH() << 16);
@@ -814,7 +931,7 @@ INLINE UINT16 READ16(UINT32 ea)
 	UINT16 value;
 	UINT32 address = ea, error;
 
-	if( ea & 0x1 ) {        /* Unaligned read */
+	if( UNALIGNED_ACCESS(ea, 0x1) ) {        /* Unaligned read */
 		value = (READ8( address+0 ) << 0);
 		value |= (READ8( address+1 ) << 8);
 	} else {
@@ -831,7 +948,7 @@ INLINE UINT32 READ32(UINT32 ea)
 	UINT32 value;
 	UINT32 address = ea, error;
 
-	if( ea & 0x3 ) {        /* Unaligned read */
+	if( UNALIGNED_ACCESS(ea, 0x3) ) {        /* Unaligned read */
 		value = (READ8( address+0 ) << 0);
 		value |= (READ8( address+1 ) << 8);
 		value |= (READ8( address+2 ) << 16),
@@ -851,7 +968,7 @@ INLINE UINT64 READ64(UINT32 ea)
 	UINT64 value;
 	UINT32 address = ea, error;
 
-	if( ea & 0x7 ) {        /* Unaligned read */
+	if( UNALIGNED_ACCESS(ea, 0x7) ) {        /* Unaligned read */
 		value = (((UINT64) READ8( address+0 )) << 0);
 		value |= (((UINT64) READ8( address+1 )) << 8);
 		value |= (((UINT64) READ8( address+2 )) << 16);
@@ -885,7 +1002,7 @@ INLINE UINT16 READ16PL0(UINT32 ea)
 	UINT16 value;
 	UINT32 address = ea, error;
 
-	if( ea & 0x1 ) {        /* Unaligned read */
+	if( UNALIGNED_ACCESS(ea, 0x1) ) {        /* Unaligned read */
 		value = (READ8PL0( address+0 ) << 0);
 		value |= (READ8PL0( address+1 ) << 8);
 	} else {
@@ -903,7 +1020,7 @@ INLINE UINT32 READ32PL0(UINT32 ea)
 	UINT32 value;
 	UINT32 address = ea, error;
 
-	if( ea & 0x3 ) {        /* Unaligned read */
+	if( UNALIGNED_ACCESS(ea, 0x3) ) {        /* Unaligned read */
 		value = (READ8PL0( address+0 ) << 0);
 		value |= (READ8PL0( address+1 ) << 8);
 		value |= (READ8PL0( address+2 ) << 16);
@@ -939,7 +1056,7 @@ INLINE void WRITE16(UINT32 ea, UINT16 value)
 {
 	UINT32 address = ea, error;
 
-	if( ea & 0x1 ) {        /* Unaligned write */
+	if( UNALIGNED_ACCESS(ea, 0x1) ) {        /* Unaligned write */
 		WRITE8( address+0, value & 0xff );
 		WRITE8( address+1, (value >> 8) & 0xff );
 	} else {
@@ -954,7 +1071,7 @@ INLINE void WRITE32(UINT32 ea, UINT32 value)
 {
 	UINT32 address = ea, error;
 
-	if( ea & 0x3 ) {        /* Unaligned write */
+	if( UNALIGNED_ACCESS(ea, 0x3) ) {        /* Unaligned write */
 		WRITE8( address+0, value & 0xff );
 		WRITE8( address+1, (value >> 8) & 0xff );
 		WRITE8( address+2, (value >> 16) & 0xff );
@@ -972,7 +1089,7 @@ INLINE void WRITE64(UINT32 ea, UINT64 value)
 {
 	UINT32 address = ea, error;
 
-	if( ea & 0x7 ) {        /* Unaligned write */
+	if( UNALIGNED_ACCESS(ea, 0x7) ) {        /* Unaligned write */
 		WRITE8( address+0, value & 0xff );
 		WRITE8( address+1, (value >> 8) & 0xff );
 		WRITE8( address+2, (value >> 16) & 0xff );
@@ -19,6 +19,7 @@
 ***************************************************************************/
 
 #include <math.h>
+#include <float.h>
 
 
 /*************************************
@@ -377,6 +378,133 @@ void x87_reset()
 }
 
 
+/*************************************
+ *
+ * Host FPU fast path
+ *
+ *************************************/
+
+/*
+    With 53-bit or 24-bit precision control, round to nearest and all
+    exceptions masked, the basic arithmetic operations give the same
+    result on the host's SSE unit as through SoftFloat. The operands are
+    only handed to the host when they convert exactly and the result is
+    a normal number, so the only flag left to track is precision.
+    Results at the bottom of the normal range are also refused: the host
+    may have rounded them up out of the denormal range, where the x87
+    with its wider exponent keeps a smaller normal value instead.
+    Everything else falls back to SoftFloat.
+
+    Precision is read straight from MXCSR: feclearexcept() and
+    fetestexcept() save and reload the x87 environment as well, which
+    costs more than the SoftFloat operation being replaced.
+*/
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2_MATH__)
+#define X87_HOST_FPU
+#endif
+
+static bool x87_host_fpu = false;
+
+#ifdef X87_HOST_FPU
+#include <xmmintrin.h>
+#ifdef _MSC_VER
+#pragma fenv_access (on)
+#endif
+
+enum
+{
+	X87_HOST_ADD,
+	X87_HOST_SUB,
+	X87_HOST_MUL,
+	X87_HOST_DIV
+};
+
+INLINE int x87_host_usable()
+{
+	const UINT16 mask = (X87_CW_RC_MASK << X87_CW_RC_SHIFT) | (1 << X87_CW_PC_SHIFT) | 0x3f;
+	return x87_host_fpu && (m_x87_cw & mask) == ((X87_CW_RC_NEAREST << X87_CW_RC_SHIFT) | 0x3f);
+}
+
+/* Converts a normal floatx80 to double, failing unless the conversion is exact */
+INLINE int x87_host_from_fx80(floatx80 fx, int single, double *out)
+{
+	int exp = (fx.high & 0x7fff) - 0x3fff;
+	UINT64 bits;
+
+	if (!(fx.low & U64(0x8000000000000000)))
+		return 0;
+	if (single ? (exp < -126 || exp > 127 || (fx.low & U64(0xffffffffff)))
+			: (exp < -1022 || exp > 1023 || (fx.low & 0x7ff)))
+		return 0;
+
+	bits = ((UINT64)(fx.high & 0x8000) << 48) | ((UINT64)(exp + 0x3ff) << 52) | ((fx.low << 1) >> 12);
+	memcpy(out, &bits, sizeof(bits));
+	return 1;
+}
+
+/* Converts a double back to floatx80, failing for denormals, the lowest binade, infinities and NaNs */
+INLINE int x87_host_to_fx80(double in, floatx80 *out)
+{
+	UINT64 bits;
+	int exp;
+
+	memcpy(&bits, &in, sizeof(bits));
+	exp = (bits >> 52) & 0x7ff;
+	if (exp <= 1 || exp == 0x7ff)
+		return 0;
+
+	out->high = ((bits >> 48) & 0x8000) | (exp - 0x3ff + 0x3fff);
+	out->low = U64(0x8000000000000000) | (bits << 11);
+	return 1;
+}
+
+static int x87_host_op(int op, floatx80 a, floatx80 b, floatx80 *result)
+{
+	int single = ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK) == X87_CW_PC_SINGLE;
+	double da, db, r;
+
+	if (!x87_host_from_fx80(a, single, &da) || !x87_host_from_fx80(b, single, &db))
+		return 0;
+
+	_mm_setcsr(_mm_getcsr() & ~_MM_EXCEPT_INEXACT);
+	if (single)
+	{
+		float fa = (float)da, fb = (float)db, fr;
+		switch (op)
+		{
+			case X87_HOST_ADD: fr = fa + fb; break;
+			case X87_HOST_SUB: fr = fa - fb; break;
+			case X87_HOST_MUL: fr = fa * fb; break;
+			default:           fr = fa / fb; break;
+		}
+		if (fabsf(fr) <= FLT_MIN || fabsf(fr) > FLT_MAX)
+			return 0;
+		r = fr;
+	}
+	else
+	{
+		switch (op)
+		{
+			case X87_HOST_ADD: r = da + db; break;
+			case X87_HOST_SUB: r = da - db; break;
+			case X87_HOST_MUL: r = da * db; break;
+			default:           r = da / db; break;
+		}
+	}
+
+	if (!x87_host_to_fx80(r, result))
+		return 0;
+	if (_mm_getcsr() & _MM_EXCEPT_INEXACT)
+		float_exception_flags |= float_flag_inexact;
+	return 1;
+}
+
+#ifdef _MSC_VER
+#pragma fenv_access (off)
+#endif
+#endif
+
+
 /*************************************
  *
  * Core arithmetic
@@ -387,6 +515,11 @@ static floatx80 x87_add(floatx80 a, floatx80 b)
 {
 	floatx80 result = { 0 };
 
+#ifdef X87_HOST_FPU
+	if (x87_host_usable() && x87_host_op(X87_HOST_ADD, a, b, &result))
+		return result;
+#endif
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -417,6 +550,11 @@ static floatx80 x87_sub(floatx80 a, floatx80 b)
 {
 	floatx80 result = { 0 };
 
+#ifdef X87_HOST_FPU
+	if (x87_host_usable() && x87_host_op(X87_HOST_SUB, a, b, &result))
+		return result;
+#endif
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -447,6 +585,11 @@ static floatx80 x87_mul(floatx80 a, floatx80 b)
 {
 	floatx80 val = { 0 };
 
+#ifdef X87_HOST_FPU
+	if (x87_host_usable() && x87_host_op(X87_HOST_MUL, a, b, &val))
+		return val;
+#endif
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -478,6 +621,11 @@ static floatx80 x87_div(floatx80 a, floatx80 b)
 {
 	floatx80 val = { 0 };
 
+#ifdef X87_HOST_FPU
+	if (x87_host_usable() && x87_host_op(X87_HOST_DIV, a, b, &val))
+		return val;
+#endif
+
 	switch ((m_x87_cw >> X87_CW_PC_SHIFT) & X87_CW_PC_MASK)
 	{
 		case X87_CW_PC_SINGLE:
@@ -1004,6 +1004,8 @@ extern "C"
         pWOWCallback16Ex = (WOWCallback16Ex_t)GetProcAddress(krnl386, "K32WOWCallback16Ex");
         HANDLE *(WINAPI *get_idle_event)() = (HANDLE *(WINAPI *)())GetProcAddress(krnl386, "get_idle_event");
         vm_idle_event = get_idle_event();
+        DWORD(WINAPI *get_config_int)(LPCSTR, LPCSTR, INT) = (DWORD(WINAPI *)(LPCSTR, LPCSTR, INT))GetProcAddress(krnl386, "krnl386_get_config_int");
+        x87_host_fpu = get_config_int("otvdm", "HostFPU", FALSE) != 0;
         //SetConsoleCtrlHandler(dump, TRUE);
 		AddVectoredExceptionHandler(TRUE, vm86_vectored_exception_handler);
 		WORD sel = SELECTOR_AllocBlock(iret, 256, WINE_LDT_FLAGS_CODE);
@@ -1379,6 +1381,7 @@ try_again:
             vm_inject_state.pdwRetCode = pdwRetCode;
             vm_inject_state.inject = TRUE;
             vm_inject_state.freed = &freed;
+            m_batch_break = 1;
             ResetEvent(inject_event);
         }
         LeaveCriticalSection(&inject_crit_section);
@@ -1388,6 +1391,7 @@ try_again:
         if (ret == (WAIT_OBJECT_0 + 1) && !freed)
         {
             vm_inject_state.inject = FALSE;
+            m_batch_break = 0;
             SetEvent(inject_event);
             goto try_again;
         }
@@ -1422,6 +1426,7 @@ try_again:
         {
             char *stack = (char *)ss_base + sp - vm_inject_state.cbArgs;
             vm_inject_state.inject = FALSE;
+            m_batch_break = 0;
             memcpy(stack, vm_inject_state.pArgs, vm_inject_state.cbArgs);
             /* push return address */
             stack -= sizeof(SEGPTR);
@@ -1469,6 +1474,11 @@ try_again:
 		)
 	{
         DWORD old_frame16 = PtrToUlong(dynamic_getWOW32Reserved());
+#if defined(HAS_I386)
+        /* a nested call must not longjmp into the block that called out */
+        jmp_buf *old_fault_jmp = m_fault_jmp;
+        m_fault_jmp = NULL;
+#endif
 		__TRY
         {
             m_task.base = (UINT32)tss - (UINT32)memory_base;
@@ -1940,7 +1950,11 @@ SREG(ES), SREG(CS), SREG(SS), SREG(DS), m_eip, read_dword(stkptr), m_eflags);
 #endif
 #if defined(HAS_I386)
 				m_cycles = 1;
-				CPU_EXECUTE_CALL(i386);
+                /* the checks above are repeated at the batch boundaries the core stops at */
+                m_batch_stop_cs = ret_addr >> 16;
+                m_batch_stop_ip = (UINT16)ret_addr;
+                m_batch_pending = V8086_MODE ? (volatile UINT32 *)&dynamic_getGdiTebBatch()->vm86_pending : NULL;
+                i386_execute_block(dasm ? 1 : I386_BBC_MAX_RUN);
 #else
 				CPU_EXECUTE_CALL(CPU_MODEL);
 #endif
@@ -1951,6 +1965,9 @@ SREG(ES), SREG(CS), SREG(SS), SREG(DS), m_eip, read_dword(stkptr), m_eflags);
 		{
 		}
 		__ENDTRY
+#if defined(HAS_I386)
+        m_fault_jmp = old_fault_jmp;
+#endif
 	}
 
 #include <imagehlp.h>
@@ -0,0 +1,564 @@
+/*
+	Standalone test and benchmark for the LDT selector allocator
+
+	ldt2.c is pulled in by textual inclusion with the Win32 headers it
+	includes kept out by their include guards, and the few types it needs
+	declared here. Every allocation, reallocation and free is replayed on
+	a copy of the old allocator, which tested wine_ldt_copy.flags[] one
+	entry at a time, and the returned selectors and flags must agree.
+
+	usage: ldtbench test [count]
+	       ldtbench bench [count]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define __WINE_CONFIG_H
+#define __WINE_WINE_PORT_H
+#define _WINDEF_
+#define __WINE_WINBASE_H
+#define __WINE_WINE_LIBRARY_H
+#define __WINE_WINE_DEBUG_H
+#define _WOWNT32_H_
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef int BOOL;
+typedef uintptr_t ULONG_PTR;
+#define TRUE 1
+#define FALSE 0
+
+typedef struct _LDT_ENTRY {
+	WORD	LimitLow;
+	WORD	BaseLow;
+	union {
+		struct {
+			BYTE    BaseMid;
+			BYTE    Flags1;
+			BYTE    Flags2;
+			BYTE    BaseHi;
+		} Bytes;
+		struct {
+			unsigned    BaseMid: 8;
+			unsigned    Type : 5;
+			unsigned    Dpl : 2;
+			unsigned    Pres : 1;
+			unsigned    LimitHi : 4;
+			unsigned    Sys : 1;
+			unsigned    Reserved_0 : 1;
+			unsigned    Default_Big : 1;
+			unsigned    Granularity : 1;
+			unsigned    BaseHi : 8;
+		} Bits;
+	} HighWord;
+} LDT_ENTRY;
+
+struct __wine_ldt_copy
+{
+	void         *base[8192];
+	unsigned long limit[8192];
+	unsigned char flags[8192];
+};
+
+#define WINE_LDT_FLAGS_32BIT     0x40
+#define WINE_LDT_FLAGS_ALLOCATED 0x80
+
+static inline void wine_ldt_set_base(LDT_ENTRY *ent, const void *base)
+{
+	ent->BaseLow               = (WORD)(ULONG_PTR)base;
+	ent->HighWord.Bits.BaseMid = (BYTE)((ULONG_PTR)base >> 16);
+	ent->HighWord.Bits.BaseHi  = (BYTE)((ULONG_PTR)base >> 24);
+}
+static inline void wine_ldt_set_limit(LDT_ENTRY *ent, unsigned int limit)
+{
+	if ((ent->HighWord.Bits.Granularity = (limit >= 0x100000))) limit >>= 12;
+	ent->LimitLow = (WORD)limit;
+	ent->HighWord.Bits.LimitHi = (limit >> 16);
+}
+static inline void *wine_ldt_get_base(const LDT_ENTRY *ent)
+{
+	return (void *)(ent->BaseLow |
+		(ULONG_PTR)ent->HighWord.Bits.BaseMid << 16 |
+		(ULONG_PTR)ent->HighWord.Bits.BaseHi << 24);
+}
+static inline unsigned int wine_ldt_get_limit(const LDT_ENTRY *ent)
+{
+	unsigned int limit = ent->LimitLow | (ent->HighWord.Bits.LimitHi << 16);
+	if (ent->HighWord.Bits.Granularity) limit = (limit << 12) | 0xfff;
+	return limit;
+}
+static inline void wine_ldt_set_flags(LDT_ENTRY *ent, unsigned char flags)
+{
+	ent->HighWord.Bits.Dpl         = 3;
+	ent->HighWord.Bits.Pres        = 1;
+	ent->HighWord.Bits.Type        = flags;
+	ent->HighWord.Bits.Sys         = 0;
+	ent->HighWord.Bits.Reserved_0  = 0;
+	ent->HighWord.Bits.Default_Big = (flags & WINE_LDT_FLAGS_32BIT) != 0;
+}
+
+#define WINE_DEFAULT_DEBUG_CHANNEL(ch)
+#define TRACE(...)
+
+void wine_ldt_free_entries(unsigned short sel, int count);
+
+#include "../ldt2.c"
+
+/* the allocator before the free bitmap, on its own copy of the flags */
+static unsigned char ref_flags[LDT_SIZE];
+static WORD ref_last_freed;
+
+static void ref_free_entries(unsigned short sel, int count)
+{
+	int index;
+
+	for (index = sel >> 3; count > 0; count--, index++)
+		ref_flags[index] = 0;
+	ref_last_freed = sel;
+}
+
+static unsigned short ref_alloc_entries(int count)
+{
+	int i, index, size = 0;
+
+	if (count <= 0)
+		return 0;
+	if ((count == 1) && ref_last_freed)
+	{
+		WORD e = ref_last_freed >> 3;
+		ref_last_freed = 0;
+		if (!(ref_flags[e] & WINE_LDT_FLAGS_ALLOCATED))
+		{
+			ref_flags[e] |= WINE_LDT_FLAGS_ALLOCATED;
+			return (e << 3) | 7;
+		}
+	}
+
+	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+	{
+		if (ref_flags[i] & WINE_LDT_FLAGS_ALLOCATED) size = 0;
+		else if (++size >= count)  /* found a large enough block */
+		{
+			index = i - size + 1;
+			for (i = 0; i < count; i++) ref_flags[index + i] |= WINE_LDT_FLAGS_ALLOCATED;
+			return (index << 3) | 7;
+		}
+	}
+	return 0;
+}
+
+static unsigned short ref_realloc_entries(unsigned short sel, int oldcount, int newcount)
+{
+	int i;
+
+	if (oldcount < newcount)
+	{
+		int index = sel >> 3;
+
+		if (index + newcount > LDT_SIZE) i = oldcount;
+		else
+			for (i = oldcount; i < newcount; i++)
+				if (ref_flags[index + i] & WINE_LDT_FLAGS_ALLOCATED) break;
+
+		if (i < newcount)
+		{
+			ref_free_entries(sel, oldcount);
+			sel = ref_alloc_entries(newcount);
+		}
+		else
+		{
+			for (i = oldcount; i < newcount; i++)
+				ref_flags[index + i] |= WINE_LDT_FLAGS_ALLOCATED;
+		}
+	}
+	else if (oldcount > newcount)
+	{
+		ref_free_entries(sel + (newcount << 3), newcount - oldcount);
+	}
+	return sel;
+}
+
+static int failures;
+static const char *test_name;
+
+static void reset(void)
+{
+	memset(&wine_ldt_copy, 0, sizeof(wine_ldt_copy));
+	memset(wine_ldt, 0, sizeof(wine_ldt));
+	memset(ldt_free_bits, 0, sizeof(ldt_free_bits));
+	memset(ldt_free_summary, 0, sizeof(ldt_free_summary));
+	ldt_free_init = FALSE;
+	last_freed = 0;
+	memset(ref_flags, 0, sizeof(ref_flags));
+	ref_last_freed = 0;
+}
+
+/* marks entries as allocated before the allocator is first used */
+static void preset(int index, int count)
+{
+	for (; count > 0; count--, index++)
+	{
+		wine_ldt_copy.flags[index] |= WINE_LDT_FLAGS_ALLOCATED;
+		ref_flags[index] |= WINE_LDT_FLAGS_ALLOCATED;
+	}
+}
+
+static void fail(const char *what, int a, int b)
+{
+	if (failures++ < 20)
+		printf("%s: %s: 0x%04x, expected 0x%04x\n", test_name, what, a, b);
+}
+
+/* the flags and the bitmap have to describe the same table */
+static void check_table(void)
+{
+	int i;
+
+	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+	{
+		int allocated = !!(wine_ldt_copy.flags[i] & WINE_LDT_FLAGS_ALLOCATED);
+
+		if (allocated != !!(ref_flags[i] & WINE_LDT_FLAGS_ALLOCATED))
+		{
+			fail("flags differ at entry", i, i);
+			return;
+		}
+		if (ldt_free_init && allocated == !!(ldt_free_bits[i / 32] & (1u << (i % 32))))
+		{
+			fail("free bitmap differs at entry", i, i);
+			return;
+		}
+	}
+	for (i = 0; ldt_free_init && i < LDT_SIZE / 32; i++)
+	{
+		if (!ldt_free_bits[i] != !(ldt_free_summary[i / 32] & (1u << (i % 32))))
+		{
+			fail("summary differs at word", i, i);
+			return;
+		}
+	}
+}
+
+static unsigned short alloc(int count)
+{
+	unsigned short sel = wine_ldt_alloc_entries(count);
+	unsigned short ref = ref_alloc_entries(count);
+
+	if (sel != ref)
+		fail("alloc", sel, ref);
+	check_table();
+	return sel;
+}
+
+static unsigned short realloc_sel(unsigned short sel, int oldcount, int newcount)
+{
+	unsigned short ret = wine_ldt_realloc_entries(sel, oldcount, newcount);
+	unsigned short ref = ref_realloc_entries(sel, oldcount, newcount);
+
+	if (ret != ref)
+		fail("realloc", ret, ref);
+	check_table();
+	return ret;
+}
+
+static void free_sel(unsigned short sel, int count)
+{
+	wine_ldt_free_entries(sel, count);
+	ref_free_entries(sel, count);
+	check_table();
+}
+
+static void expect(unsigned short sel, int index)
+{
+	unsigned short want = index ? (index << 3) | 7 : 0;
+
+	if (sel != want)
+		fail("selector", sel, want);
+}
+
+#define SEL(index) (((index) << 3) | 7)
+
+static void test_first_fit(void)
+{
+	test_name = "first fit";
+	reset();
+	expect(alloc(4), 512);
+	expect(alloc(3), 516);
+	expect(alloc(1), 519);
+	expect(alloc(8), 520);
+	expect(alloc(1), 528);
+	free_sel(SEL(516), 3);
+	free_sel(SEL(520), 8);
+	/* the first hole is too small, the second one is taken */
+	expect(alloc(5), 520);
+	expect(alloc(6), 529);
+	expect(alloc(3), 516);
+	expect(alloc(3), 525);
+	expect(alloc(1), 535);
+
+	/* entries already in use when the allocator is first called */
+	reset();
+	preset(512, 100);
+	preset(620, 1);
+	expect(alloc(8), 612);
+	expect(alloc(1), 621);
+}
+
+static void test_word_crossing(void)
+{
+	test_name = "word crossing";
+	reset();
+	expect(alloc(30), 512);
+	/* 542..545 straddles the word starting at 544 */
+	expect(alloc(4), 542);
+	expect(alloc(64), 546);
+	free_sel(SEL(540), 8);
+	expect(alloc(9), 610);
+	expect(alloc(8), 540);
+
+	/* a hole across the 1024 entry summary boundary */
+	reset();
+	expect(alloc(1536), 512);
+	free_sel(SEL(1020), 8);
+	expect(alloc(9), 2048);
+	expect(alloc(8), 1020);
+
+	/* a single free entry behind a fully allocated 1024 entry span */
+	reset();
+	expect(alloc(LDT_SIZE - LDT_FIRST_ENTRY), 512);
+	free_sel(SEL(3000), 1);
+	expect(alloc(2), 0);
+	expect(alloc(1), 3000);
+	free_sel(SEL(4095), 1);
+	free_sel(SEL(4096), 1);
+	expect(alloc(2), 4095);
+	/* the first word after a skipped span */
+	free_sel(SEL(2048), 2);
+	expect(alloc(2), 2048);
+}
+
+static void test_free_reopens(void)
+{
+	unsigned short a, b, c;
+
+	test_name = "free reopens";
+	reset();
+	a = alloc(4);
+	b = alloc(4);
+	c = alloc(4);
+	expect(alloc(1), 524);
+	free_sel(a, 4);
+	free_sel(b, 4);
+	expect(alloc(8), 512);
+	/* freed in the other order, the run reopens with its neighbour */
+	free_sel(c, 4);
+	free_sel(SEL(516), 4);
+	expect(alloc(8), 516);
+	free_sel(SEL(512), 1);
+	expect(alloc(1), 512);
+
+	/* growing in place and moving once the next entries are taken */
+	reset();
+	a = alloc(2);
+	expect(alloc(1), 514);
+	expect(realloc_sel(a, 2, 1), 512);
+	expect(realloc_sel(a, 2, 4), 515);
+	expect(realloc_sel(SEL(515), 4, 6), 515);
+	expect(alloc(2), 512);
+}
+
+static void test_exhaustion(void)
+{
+	unsigned short a;
+
+	test_name = "exhaustion";
+	reset();
+	expect(alloc(LDT_SIZE - LDT_FIRST_ENTRY - 1), 512);
+	expect(alloc(2), 0);
+	expect(alloc(1), LDT_SIZE - 1);
+	expect(alloc(1), 0);
+	free_sel(SEL(LDT_SIZE - 1), 1);
+	expect(alloc(1), LDT_SIZE - 1);
+	/* a run that ends on the last entry */
+	free_sel(SEL(LDT_SIZE - 4), 4);
+	expect(alloc(5), 0);
+	expect(alloc(4), LDT_SIZE - 4);
+	/* growing past the last entry has to move, and there is no room */
+	free_sel(SEL(LDT_SIZE - 2), 2);
+	a = alloc(2);
+	expect(a, LDT_SIZE - 2);
+	expect(realloc_sel(a, 2, 3), 0);
+	expect(alloc(2), LDT_SIZE - 2);
+}
+
+static DWORD rng = 2463534242u;
+
+static unsigned random32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+struct block
+{
+	unsigned short sel;
+	int count;
+};
+
+static struct block blocks[LDT_SIZE];
+
+/* small blocks with now and then a large one, as Win16 programs allocate */
+static int random_count(void)
+{
+	unsigned r = random32();
+
+	if (r % 64 == 0)
+		return 1 + r / 64 % 256;
+	return 1 + r / 64 % (r % 4 ? 2 : 16);
+}
+
+static void test_random(int count)
+{
+	int live = 0, i;
+
+	test_name = "random";
+	reset();
+	preset(700, 3);
+	for (i = 0; i < count; i++)
+	{
+		unsigned r = random32() % 8;
+
+		if (live && (r < 3 || live > 2000))
+		{
+			int n = random32() % live;
+
+			free_sel(blocks[n].sel, blocks[n].count);
+			blocks[n] = blocks[--live];
+		}
+		else if (live && r == 3)
+		{
+			int n = random32() % live;
+			int newcount = random_count();
+			unsigned short sel = realloc_sel(blocks[n].sel, blocks[n].count, newcount);
+
+			/* shrinking leaves the tail allocated, count it as part of the block */
+			if (newcount < blocks[n].count)
+				newcount = blocks[n].count;
+			if (sel)
+			{
+				blocks[n].sel = sel;
+				blocks[n].count = newcount;
+			}
+			else
+				blocks[n] = blocks[--live];
+		}
+		else
+		{
+			int n = random_count();
+			unsigned short sel = alloc(n);
+
+			if (sel)
+			{
+				blocks[live].sel = sel;
+				blocks[live].count = n;
+				live++;
+			}
+		}
+		if (failures)
+			break;
+	}
+}
+
+static int test(int count)
+{
+	test_first_fit();
+	test_word_crossing();
+	test_free_reopens();
+	test_exhaustion();
+	test_random(count);
+	if (failures)
+	{
+		printf("ldt: %d failures\n", failures);
+		return 1;
+	}
+	printf("ldt: ok\n");
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* a table about 3/4 full with single entry holes, then alloc/free churn */
+static double churn(unsigned short (*alloc_fn)(int), void (*free_fn)(unsigned short, int), int count)
+{
+	double start;
+	int live = 0, i;
+
+	rng = 88172645u;
+	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE * 3 / 4; i++)
+		alloc_fn(1);
+	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE * 3 / 4; i += 5)
+		free_fn(SEL(i), 1);
+	alloc_fn(2);
+
+	start = now();
+	for (i = 0; i < count; i++)
+	{
+		if (live == 64)
+		{
+			int n = random32() % live;
+
+			free_fn(blocks[n].sel, blocks[n].count);
+			blocks[n] = blocks[--live];
+		}
+		blocks[live].count = random_count() + 1;
+		blocks[live].sel = alloc_fn(blocks[live].count);
+		if (blocks[live].sel)
+			live++;
+	}
+	return (now() - start) / count * 1e9;
+}
+
+static int bench(int count)
+{
+	double bitmap, linear;
+
+	reset();
+	bitmap = churn(wine_ldt_alloc_entries, wine_ldt_free_entries, count);
+	reset();
+	linear = churn(ref_alloc_entries, ref_free_entries, count);
+	printf("alloc  bitmap %8.1f ns  linear %8.1f ns  (%d allocations)\n", bitmap, linear, count);
+	return 0;
+}
+
+static int usage(void)
+{
+	fprintf(stderr, "usage: ldtbench test [count]\n"
+		"       ldtbench bench [count]\n");
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	int count;
+
+	if (argc < 2)
+		return usage();
+	count = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+	if (!strcmp(argv[1], "test"))
+		return test(count ? count : 200000);
+	if (!strcmp(argv[1], "bench"))
+		return bench(count ? count : 1000000);
+	return usage();
+}
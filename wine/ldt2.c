@@ -8,6 +8,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include "windef.h"
 #include "winbase.h"
@@ -29,6 +32,111 @@ static void(*unlock_ldt)(void) = nop;
 #define LDT_FIRST_ENTRY 512
 #define LDT_SIZE 8192
 
+/* free entries, one bit per entry (1 = free) */
+static DWORD ldt_free_bits[LDT_SIZE / 32];
+/* bit n is set if ldt_free_bits[n] is not zero */
+static DWORD ldt_free_summary[LDT_SIZE / 32 / 32];
+static BOOL ldt_free_init;
+
+/* v must not be zero */
+static inline int lowest_bit(DWORD v)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(v);
+#elif defined(_MSC_VER)
+	unsigned long b;
+	_BitScanForward(&b, v);
+	return b;
+#else
+	int b = 0;
+	while (!(v & 1))
+	{
+		v >>= 1;
+		b++;
+	}
+	return b;
+#endif
+}
+
+static void ldt_set_free(int index)
+{
+	if (index < LDT_FIRST_ENTRY || index >= LDT_SIZE) return;
+	ldt_free_bits[index / 32] |= 1u << (index % 32);
+	ldt_free_summary[index / 1024] |= 1u << (index / 32 % 32);
+}
+
+static void ldt_set_allocated(int index)
+{
+	ldt_free_bits[index / 32] &= ~(1u << (index % 32));
+	if (!ldt_free_bits[index / 32])
+		ldt_free_summary[index / 1024] &= ~(1u << (index / 32 % 32));
+	wine_ldt_copy.flags[index] |= WINE_LDT_FLAGS_ALLOCATED;
+}
+
+static void init_free_map(void)
+{
+	int i;
+	if (ldt_free_init) return;
+	ldt_free_init = TRUE;
+	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+		if (!(wine_ldt_copy.flags[i] & WINE_LDT_FLAGS_ALLOCATED)) ldt_set_free(i);
+}
+
+/* first allocated entry >= index, or LDT_SIZE */
+static int ldt_next_allocated(int index)
+{
+	int w = index / 32;
+	DWORD bits = ~ldt_free_bits[w] & (~0u << (index % 32));
+
+	if (bits) return w * 32 + lowest_bit(bits);
+	for (w++; w < LDT_SIZE / 32; w++)
+		if (ldt_free_bits[w] != ~0u) return w * 32 + lowest_bit(~ldt_free_bits[w]);
+	return LDT_SIZE;
+}
+
+/* bit i of the result is set if bits i to i + n - 1 of v are, 1 <= n <= 32 */
+static inline unsigned long long run_starts(unsigned long long v, int n)
+{
+	int s;
+
+	for (s = 1; s * 2 <= n; s *= 2) v &= v >> s;
+	if (s < n) v &= v >> (n - s);
+	return v;
+}
+
+/* first entry of the first free run of count entries, or LDT_SIZE */
+static int ldt_find_run(int count)
+{
+	int n = count < 32 ? count : 32;
+	int w, start, end;
+	unsigned long long bits;
+
+	for (w = LDT_FIRST_ENTRY / 32; w < LDT_SIZE / 32; w++)
+	{
+		/* skip 1024 allocated entries at once */
+		if (!(w % 32) && !ldt_free_summary[w / 32])
+		{
+			w += 31;
+			continue;
+		}
+		if (!ldt_free_bits[w]) continue;
+
+		/* look at the next word too for runs crossing into it */
+		bits = ldt_free_bits[w];
+		if (w + 1 < LDT_SIZE / 32) bits |= (unsigned long long)ldt_free_bits[w + 1] << 32;
+		bits = run_starts(bits, n) & 0xffffffff;
+		if (!bits) continue;
+
+		start = w * 32 + lowest_bit((DWORD)bits);
+		if (count <= 32) return start;
+		end = ldt_next_allocated(start);
+		if (end - start >= count) return start;
+		/* too short, carry on with the word it ends in */
+		w = end / 32 - 1;
+	}
+	return LDT_SIZE;
+}
+
 /***********************************************************************
  *           wine_ldt_get_ptr
  *
@@ -121,7 +229,7 @@ unsigned short sel = 0x1000;
 unsigned short wine_ldt_alloc_entries(int count)
 {
 
-	int i, index, size = 0;
+	int i, index;
 
 	if (count <= 0)
 	{
@@ -129,31 +237,27 @@ unsigned short wine_ldt_alloc_entries(int count)
 		return 0;
 	}
 	lock_ldt();
+	init_free_map();
 	if ((count == 1) && last_freed)
 	{
 		WORD e = last_freed >> 3;
 		last_freed = 0;
 	 	if (!(wine_ldt_copy.flags[e] & WINE_LDT_FLAGS_ALLOCATED))
 		{
-			wine_ldt_copy.flags[e] |= WINE_LDT_FLAGS_ALLOCATED;
+			ldt_set_allocated(e);
 			unlock_ldt();
 			return (e << 3) | 7;
 		}
 	}
 
-	for (i = LDT_FIRST_ENTRY; i < LDT_SIZE; i++)
+	index = ldt_find_run(count);
+	if (index < LDT_SIZE)  /* found a large enough block */
 	{
-		if (wine_ldt_copy.flags[i] & WINE_LDT_FLAGS_ALLOCATED) size = 0;
-		else if (++size >= count)  /* found a large enough block */
-		{
-			index = i - size + 1;
-
-			/* mark selectors as allocated */
-			for (i = 0; i < count; i++) wine_ldt_copy.flags[index + i] |= WINE_LDT_FLAGS_ALLOCATED;
-			unlock_ldt();
-			//DPRINTF("NOTIMPL:wine_ldt_alloc_entries(%d) = %d\n", count, (index << 3) | 7);
-			return (index << 3) | 7;
-		}
+		/* mark selectors as allocated */
+		for (i = 0; i < count; i++) ldt_set_allocated(index + i);
+		unlock_ldt();
+		//DPRINTF("NOTIMPL:wine_ldt_alloc_entries(%d) = %d\n", count, (index << 3) | 7);
+		return (index << 3) | 7;
 	}
 	unlock_ldt();
 	TRACE("wine_ldt_alloc_entries(%d) = %d\n", count, 0);
@@ -180,6 +284,7 @@ unsigned short wine_ldt_realloc_entries(unsigned short sel, int oldcount, int ne
 		int index = sel >> 3;
 
 		lock_ldt();
+		init_free_map();
 		/* check if the next selectors are free */
 		if (index + newcount > LDT_SIZE) i = oldcount;
 		else
@@ -194,7 +299,7 @@ unsigned short wine_ldt_realloc_entries(unsigned short sel, int oldcount, int ne
 		else  /* mark the selectors as allocated */
 		{
 			for (i = oldcount; i < newcount; i++)
-				wine_ldt_copy.flags[index + i] |= WINE_LDT_FLAGS_ALLOCATED;
+				ldt_set_allocated(index + i);
 		}
 		unlock_ldt();
 	}
@@ -238,10 +343,12 @@ void wine_ldt_free_entries(unsigned short sel, int count)
 	int index;
 
 	lock_ldt();
+	init_free_map();
 	for (index = sel >> 3; count > 0; count--, index++)
 	{
 		internal_set_entry(sel, &null_entry);
 		wine_ldt_copy.flags[index] = 0;
+		ldt_set_free(index);
 	}
 	last_freed = sel;
 	unlock_ldt();